@@ -4,14 +4,40 @@ out vec4 FragColor;
 
 uniform vec3 u_LightPos;
 uniform float u_Ambient;
+// Light from the open sky, only added where the bake says how much of it is open
+uniform float u_SkyLight;
+uniform vec2 u_TexRes;
+// 1 where the viewshed's observer sees the grid point
+uniform sampler2D u_Viewshed;
+uniform bool u_ShowViewshed;
+// Baked ambient occlusion in red & how much of the sun each grid point sees in green
+uniform sampler2D u_Bake;
+uniform bool u_UseBake;
+// Octahedral normals per grid point, used instead of the interpolated vertex normal when set
+uniform sampler2D u_Normals;
+uniform bool u_NormalMap;
 
 in vec3 oNormal;
 in vec3 oPos;
 
 void main() {
     vec4 color = vec4(0.0, 1.0, 0.0, 1.0);
+    vec2 uv = (oPos.xz + (u_TexRes - 1.0) * 0.5 + 0.5) / u_TexRes;
+    vec3 normal = oNormal;
+    if(u_NormalMap) {
+        vec2 e = texture(u_Normals, uv).rg;
+        normal = normalize(vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y));
+    }
     vec3 lightDir = normalize(u_LightPos - oPos);
-    float f = max(dot(oNormal, lightDir), 0.0);
-    f += u_Ambient;
+    float f = max(dot(normal, lightDir), 0.0);
+    if(u_UseBake) {
+        vec2 bake = texture(u_Bake, uv).rg;
+        f = f * bake.g + (u_Ambient + u_SkyLight) * bake.r;
+    } else {
+        f += u_Ambient;
+    }
+    if(u_ShowViewshed) {
+        color.rgb = mix(vec3(0.6, 0.1, 0.1), color.rgb, texture(u_Viewshed, uv).r);
+    }
     FragColor = color * f;
 }
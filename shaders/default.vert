@@ -1,6 +1,9 @@
 #version 330 core
 
 layout (location = 0) in vec3 pos;
+layout (location = 1) in vec2 packedNormal;
+// Grid x & z of the patch's first vertex and the grid units between its vertices
+layout (location = 2) in vec3 patchOffsetScale;
 
 uniform mat4 u_Proj;
 uniform mat4 u_View;
@@ -8,6 +11,13 @@ uniform mat4 u_View;
 uniform sampler2D u_Tex;
 uniform vec2 u_TexRes;
 uniform float u_MaxHeight;
+// The fragment shader reads the normals from the baked normal map
+uniform bool u_NormalMap;
+// The compute shader path leaves the mesh flat and only writes the texture
+uniform bool u_HeightFromTex;
+// 0 is float positions, 1 packed 16 bit grid coordinates & height, 2 packed with a normal,
+// 3 the instanced patch whose heights always come from the texture
+uniform int u_VertexFormat;
 
 out vec3 oNormal;
 out vec3 oPos;
@@ -17,8 +27,30 @@ float getHeight(vec2 uv) {
 }
 
 void main() {
-    vec2 uv = pos.xz/u_TexRes + 0.5;
-    gl_Position = u_Proj * u_View * vec4(pos, 1.0);
+    vec3 p = pos;
+    if(u_VertexFormat == 3) {
+        // Patches hanging over the last row or column fold onto it
+        vec2 grid = min(patchOffsetScale.xy + pos.xz * patchOffsetScale.z, u_TexRes - 1.0);
+        p = vec3(grid.x - (u_TexRes.x - 1.0) * 0.5, 0.0, grid.y - (u_TexRes.y - 1.0) * 0.5);
+    } else if(u_VertexFormat != 0) {
+        p = vec3(pos.x - (u_TexRes.x - 1.0) * 0.5, pos.y / 65535.0 * u_MaxHeight, pos.z - (u_TexRes.y - 1.0) * 0.5);
+    }
+
+    vec2 uv = p.xz/u_TexRes + 0.5;
+    if(u_HeightFromTex || u_VertexFormat == 3)
+        p.y = getHeight(uv) * u_MaxHeight;
+    gl_Position = u_Proj * u_View * vec4(p, 1.0);
+    oPos = p;
+
+    if(u_NormalMap) {
+        oNormal = vec3(0.0, 1.0, 0.0);
+        return;
+    }
+    if(u_VertexFormat == 2) {
+        // Upper half of an octahedron
+        oNormal = normalize(vec3(packedNormal.x, 1.0 - abs(packedNormal.x) - abs(packedNormal.y), packedNormal.y));
+        return;
+    }
 
     vec2 texel = vec2(1.0/u_TexRes.x, 1.0/u_TexRes.y);
     uv = clamp(uv, texel, vec2(1.0) - texel);
@@ -32,5 +64,4 @@ void main() {
     vec3 Tz = vec3(0.0, U - D, 2.0);
 
     oNormal = normalize(cross(Tz, Tx));
-    oPos = pos;
 }
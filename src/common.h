@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdio.h>
+
+#define ARR_LEN(arr) (sizeof(arr)/sizeof(arr[0]))
+
+#define INFO(msg, ...) do { fprintf(stdout, "INFO: "); fprintf(stdout, msg, ##__VA_ARGS__); } while(0)
+#define ERROR(msg, ...) do { fprintf(stderr, "ERROR: "); fprintf(stderr, msg, ##__VA_ARGS__); } while(0)
@@ -0,0 +1,157 @@
+#include "gpugen.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+
+#define GPUGEN_GROUP_SIZE 8
+
+// glad only loads GL 3.3, the few 4.3 entry points needed here are fetched by hand
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_TEXTURE_UPDATE_BARRIER_BIT 0x00000100
+
+typedef void (APIENTRYP DispatchComputeFn)(GLuint x, GLuint y, GLuint z);
+typedef void (APIENTRYP BindImageTextureFn)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP MemoryBarrierFn)(GLbitfield barriers);
+
+static DispatchComputeFn dispatchCompute;
+static BindImageTextureFn bindImageTexture;
+static MemoryBarrierFn memoryBarrier;
+
+// Copied from stb_perlin, its tables are static so they can't be referenced
+static const uint8_t perlinRandtab[256] = {
+    23, 125, 161, 52, 103, 117, 70, 37, 247, 101, 203, 169, 124, 126, 44, 123,
+    152, 238, 145, 45, 171, 114, 253, 10, 192, 136, 4, 157, 249, 30, 35, 72,
+    175, 63, 77, 90, 181, 16, 96, 111, 133, 104, 75, 162, 93, 56, 66, 240,
+    8, 50, 84, 229, 49, 210, 173, 239, 141, 1, 87, 18, 2, 198, 143, 57,
+    225, 160, 58, 217, 168, 206, 245, 204, 199, 6, 73, 60, 20, 230, 211, 233,
+    94, 200, 88, 9, 74, 155, 33, 15, 219, 130, 226, 202, 83, 236, 42, 172,
+    165, 218, 55, 222, 46, 107, 98, 154, 109, 67, 196, 178, 127, 158, 13, 243,
+    65, 79, 166, 248, 25, 224, 115, 80, 68, 51, 184, 128, 232, 208, 151, 122,
+    26, 212, 105, 43, 179, 213, 235, 148, 146, 89, 14, 195, 28, 78, 112, 76,
+    250, 47, 24, 251, 140, 108, 186, 190, 228, 170, 183, 139, 39, 188, 244, 246,
+    132, 48, 119, 144, 180, 138, 134, 193, 82, 182, 120, 121, 86, 220, 209, 3,
+    91, 241, 149, 85, 205, 150, 113, 216, 31, 100, 41, 164, 177, 214, 153, 231,
+    38, 71, 185, 174, 97, 201, 29, 95, 7, 92, 54, 254, 191, 118, 34, 221,
+    131, 11, 163, 99, 234, 81, 227, 147, 156, 176, 17, 142, 69, 12, 110, 62,
+    27, 255, 0, 194, 59, 116, 242, 252, 19, 21, 187, 53, 207, 129, 64, 135,
+    61, 40, 167, 237, 102, 223, 106, 159, 197, 189, 215, 137, 36, 32, 22, 5,
+};
+
+static const uint8_t perlinGradIdx[256] = {
+    7, 9, 5, 0, 11, 1, 6, 9, 3, 9, 11, 1, 8, 10, 4, 7,
+    8, 6, 1, 5, 3, 10, 9, 10, 0, 8, 4, 1, 5, 2, 7, 8,
+    7, 11, 9, 10, 1, 0, 4, 7, 5, 0, 11, 6, 1, 4, 2, 8,
+    8, 10, 4, 9, 9, 2, 5, 7, 9, 1, 7, 2, 2, 6, 11, 5,
+    5, 4, 6, 9, 0, 1, 1, 0, 7, 6, 9, 8, 4, 10, 3, 1,
+    2, 8, 8, 9, 10, 11, 5, 11, 11, 2, 6, 10, 3, 4, 2, 4,
+    9, 10, 3, 2, 6, 3, 6, 10, 5, 3, 4, 10, 11, 2, 9, 11,
+    1, 11, 10, 4, 9, 4, 11, 0, 4, 11, 4, 0, 0, 0, 7, 6,
+    10, 4, 1, 3, 11, 5, 3, 4, 2, 9, 1, 3, 0, 1, 8, 0,
+    6, 7, 8, 7, 0, 4, 6, 10, 8, 2, 3, 11, 11, 8, 0, 2,
+    4, 8, 3, 0, 0, 10, 6, 1, 2, 2, 4, 5, 6, 0, 1, 3,
+    11, 9, 5, 5, 9, 6, 9, 8, 3, 8, 1, 8, 9, 6, 9, 11,
+    10, 7, 5, 6, 5, 9, 1, 3, 7, 0, 2, 10, 11, 2, 6, 1,
+    3, 11, 7, 7, 2, 1, 7, 3, 0, 8, 1, 1, 5, 0, 6, 10,
+    11, 11, 0, 2, 7, 0, 10, 8, 3, 5, 7, 1, 11, 1, 0, 7,
+    9, 0, 11, 5, 10, 3, 2, 3, 5, 9, 7, 9, 8, 4, 6, 5,
+};
+
+bool gpuGenInit(GpuGen* gen, const char* source) {
+    memset(gen, 0, sizeof(GpuGen));
+
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if(major * 10 + minor < 43) {
+        ERROR("Compute shaders need GL 4.3, got %d.%d!\n", major, minor);
+        return false;
+    }
+
+    dispatchCompute = (DispatchComputeFn)glfwGetProcAddress("glDispatchCompute");
+    bindImageTexture = (BindImageTextureFn)glfwGetProcAddress("glBindImageTexture");
+    memoryBarrier = (MemoryBarrierFn)glfwGetProcAddress("glMemoryBarrier");
+    if(!dispatchCompute || !bindImageTexture || !memoryBarrier) {
+        ERROR("Couldn't load the GL 4.3 compute functions!\n");
+        return false;
+    }
+
+    char log[1024];
+    int success = false;
+    uint32_t shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if(!success) {
+        glGetShaderInfoLog(shader, sizeof(log), 0, log);
+        ERROR("%s", log);
+        glDeleteShader(shader);
+        return false;
+    }
+
+    gen->program = glCreateProgram();
+    glAttachShader(gen->program, shader);
+    glLinkProgram(gen->program);
+    glDeleteShader(shader);
+    glGetProgramiv(gen->program, GL_LINK_STATUS, &success);
+    if(!success) {
+        glGetProgramInfoLog(gen->program, sizeof(log), 0, log);
+        ERROR("%s", log);
+        glDeleteProgram(gen->program);
+        gen->program = 0;
+        return false;
+    }
+
+    // Both tables twice like stb does, so 'table[a + b]' never needs a mask
+    uint32_t tables[1024];
+    for(uint32_t i = 0; i < 512; i++) {
+        tables[i] = perlinRandtab[i & 255];
+        tables[512 + i] = perlinGradIdx[i & 255];
+    }
+    glGenBuffers(1, &gen->tables);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gen->tables);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(tables), tables, GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    gen->available = true;
+    return true;
+}
+
+void gpuGenDestroy(GpuGen* gen) {
+    if(gen->tables)
+        glDeleteBuffers(1, &gen->tables);
+    if(gen->program)
+        glDeleteProgram(gen->program);
+    memset(gen, 0, sizeof(GpuGen));
+}
+
+void gpuGenRun(GpuGen* gen, uint32_t tex, uint32_t width, uint32_t height, int octaves, int seed, float scale) {
+    // Image stores need a sized format
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glUseProgram(gen->program);
+    glUniform2ui(glGetUniformLocation(gen->program, "u_Size"), width, height);
+    glUniform1i(glGetUniformLocation(gen->program, "u_Octaves"), octaves);
+    // stb_perlin only uses the low byte of the seed
+    glUniform1ui(glGetUniformLocation(gen->program, "u_Seed"), (uint32_t)seed & 255);
+    glUniform1f(glGetUniformLocation(gen->program, "u_Scale"), scale);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gen->tables);
+    bindImageTexture(0, tex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+    dispatchCompute((width + GPUGEN_GROUP_SIZE - 1) / GPUGEN_GROUP_SIZE, (height + GPUGEN_GROUP_SIZE - 1) / GPUGEN_GROUP_SIZE, 1);
+    memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
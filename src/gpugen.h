@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Evaluates the default fbm (the same sum as getPerlin2D) in a GL 4.3 compute
+// shader, straight into the heightmap texture
+typedef struct {
+    bool available;
+    uint32_t program;
+    // stb_perlin's permutation & gradient tables
+    uint32_t tables;
+} GpuGen;
+
+// Needs a current GL 4.3 context, returns false (and leaves the generator
+// unavailable) when compute shaders aren't supported
+bool gpuGenInit(GpuGen* gen, const char* source);
+void gpuGenDestroy(GpuGen* gen);
+// (Re)allocates 'tex' as a width x height RGBA8 texture and fills it, the
+// height of grid point (x, y) is getPerlin2D(x * scale, y * scale, octaves, seed)
+void gpuGenRun(GpuGen* gen, uint32_t tex, uint32_t width, uint32_t height, int octaves, int seed, float scale);
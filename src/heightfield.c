@@ -0,0 +1,138 @@
+#include "heightfield.h"
+
+#include <math.h>
+
+#include "jobs.h"
+#include "simd.h"
+
+// Points per piece of a threaded query, smaller batches run on the calling thread
+#define HEIGHTFIELD_GRAIN 4096
+
+typedef struct {
+    const HeightField* field;
+    const float* xs;
+    const float* zs;
+    uint32_t count;
+    float* heights;
+    float* normals;
+} QueryJob;
+
+// Also sends NaN to 'lo'
+static inline float clampCoord(float x, float lo, float hi) {
+    return x >= lo ? (x <= hi ? x : hi) : lo;
+}
+
+static inline F4 clampCoord4(F4 x, F4 lo, F4 hi) {
+    x = f4Select(lo, x, f4Less(lo, x));
+    return f4Select(hi, x, f4Less(x, hi));
+}
+
+void heightFieldInit(HeightField* field, const uint32_t* texels, uint32_t width, uint32_t height, float unitHeight) {
+    field->texels = texels;
+    field->width = width;
+    field->height = height;
+    field->unitHeight = unitHeight;
+    field->originX = -(width - 1) / 2.0f;
+    field->originZ = -(height - 1) / 2.0f;
+}
+
+float heightFieldSample(const HeightField* field, float x, float z, float normal[3]) {
+    float gx = clampCoord(x - field->originX, 0.0f, (float)(field->width - 1));
+    float gz = clampCoord(z - field->originZ, 0.0f, (float)(field->height - 1));
+    // The last row & column interpolate within the cell before them
+    uint32_t ix = (uint32_t)gx < field->width - 2 ? (uint32_t)gx : field->width - 2;
+    uint32_t iz = (uint32_t)gz < field->height - 2 ? (uint32_t)gz : field->height - 2;
+    float fx = gx - ix, fz = gz - iz;
+
+    const uint32_t* row = field->texels + (size_t)iz * field->width + ix;
+    float h00 = (row[0] & 0xff) * field->unitHeight;
+    float h10 = (row[1] & 0xff) * field->unitHeight;
+    float h01 = (row[field->width] & 0xff) * field->unitHeight;
+    float h11 = (row[field->width + 1] & 0xff) * field->unitHeight;
+
+    float h0 = h00 + (h10 - h00) * fx;
+    float h1 = h01 + (h11 - h01) * fx;
+    if(normal) {
+        float dx = (h10 - h00) + ((h11 - h01) - (h10 - h00)) * fz;
+        float dz = h1 - h0;
+        float length = sqrtf(dx * dx + 1.0f + dz * dz);
+        normal[0] = -dx / length;
+        normal[1] = 1.0f / length;
+        normal[2] = -dz / length;
+    }
+    return h0 + (h1 - h0) * fz;
+}
+
+static void queryRange(void* user, uint32_t begin, uint32_t end) {
+    const QueryJob* job = user;
+    const HeightField* field = job->field;
+    uint32_t first = begin * HEIGHTFIELD_GRAIN;
+    uint32_t last = end * HEIGHTFIELD_GRAIN < job->count ? end * HEIGHTFIELD_GRAIN : job->count;
+
+    F4 originX = f4Set1(field->originX), originZ = f4Set1(field->originZ);
+    F4 zero = f4Set1(0.0f);
+    F4 maxX = f4Set1((float)(field->width - 1)), maxZ = f4Set1((float)(field->height - 1));
+    I4 lastCellX = i4Set1((int32_t)field->width - 2), lastCellZ = i4Set1((int32_t)field->height - 2);
+    F4 unit = f4Set1(field->unitHeight);
+    F4 one = f4Set1(1.0f);
+
+    uint32_t i = first;
+    for(; i + 4 <= last; i += 4) {
+        F4 gx = clampCoord4(f4Sub(f4Load(job->xs + i), originX), zero, maxX);
+        F4 gz = clampCoord4(f4Sub(f4Load(job->zs + i), originZ), zero, maxZ);
+        I4 ix = i4Truncate(gx), iz = i4Truncate(gz);
+        // min(ix, lastCell) as ix - max(ix - lastCell, 0), both are non negative
+        I4 overX = i4Sub(ix, lastCellX), overZ = i4Sub(iz, lastCellZ);
+        ix = i4Sub(ix, i4AndNot(i4Sar(overX, 31), overX));
+        iz = i4Sub(iz, i4AndNot(i4Sar(overZ, 31), overZ));
+        F4 fx = f4Sub(gx, f4FromI4(ix)), fz = f4Sub(gz, f4FromI4(iz));
+
+        // SSE2 has no gathers, the corners are fetched lane by lane
+        int32_t cx[4], cz[4];
+        i4Store(cx, ix);
+        i4Store(cz, iz);
+        float c00[4], c10[4], c01[4], c11[4];
+        for(uint32_t l = 0; l < 4; l++) {
+            const uint32_t* row = field->texels + (size_t)cz[l] * field->width + cx[l];
+            c00[l] = (float)(row[0] & 0xff);
+            c10[l] = (float)(row[1] & 0xff);
+            c01[l] = (float)(row[field->width] & 0xff);
+            c11[l] = (float)(row[field->width + 1] & 0xff);
+        }
+        F4 h00 = f4Mul(f4Load(c00), unit), h10 = f4Mul(f4Load(c10), unit);
+        F4 h01 = f4Mul(f4Load(c01), unit), h11 = f4Mul(f4Load(c11), unit);
+
+        F4 h0 = f4Add(h00, f4Mul(f4Sub(h10, h00), fx));
+        F4 h1 = f4Add(h01, f4Mul(f4Sub(h11, h01), fx));
+        f4Store(job->heights + i, f4Add(h0, f4Mul(f4Sub(h1, h0), fz)));
+
+        if(job->normals) {
+            F4 slope0 = f4Sub(h10, h00);
+            F4 dx = f4Add(slope0, f4Mul(f4Sub(f4Sub(h11, h01), slope0), fz));
+            F4 dz = f4Sub(h1, h0);
+            F4 inverse = f4Div(one, f4Sqrt(f4Add(f4Add(f4Mul(dx, dx), one), f4Mul(dz, dz))));
+            f4Store(job->normals + i, f4Mul(f4Sub(zero, dx), inverse));
+            f4Store(job->normals + job->count + i, inverse);
+            f4Store(job->normals + 2 * (size_t)job->count + i, f4Mul(f4Sub(zero, dz), inverse));
+        }
+    }
+    for(; i < last; i++) {
+        float normal[3];
+        job->heights[i] = heightFieldSample(field, job->xs[i], job->zs[i], job->normals ? normal : 0);
+        if(job->normals) {
+            job->normals[i] = normal[0];
+            job->normals[job->count + i] = normal[1];
+            job->normals[2 * (size_t)job->count + i] = normal[2];
+        }
+    }
+}
+
+void heightFieldQuery(const HeightField* field, const float* xs, const float* zs, uint32_t count, float* heights, float* normals) {
+    QueryJob job = { field, xs, zs, count, heights, normals };
+    uint32_t pieces = (count + HEIGHTFIELD_GRAIN - 1) / HEIGHTFIELD_GRAIN;
+    if(pieces <= 1) {
+        queryRange(&job, 0, pieces);
+        return;
+    }
+    jobsParallelFor(pieces, 1, queryRange, &job);
+}
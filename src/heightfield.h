@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Bilinear height & normal queries on a heightmap for batches of points, laid out as
+// separate x & z arrays. Grid points are a unit apart with grid point (0, 0) at
+// (originX, originZ), heights are scaled by 'unitHeight' like the mesh's.
+//
+// Positions are clamped onto the grid before sampling, so points past an edge get the
+// height & normal of the closest point on it, and NaN coordinates read the grid's first
+// row or column. Normals are the normalized gradient of the bilinear surface itself.
+typedef struct {
+    // RGBA8 texels with the height in red, not owned
+    const uint32_t* texels;
+    uint32_t width, height;
+    float unitHeight;
+    float originX, originZ;
+} HeightField;
+
+// Centres the grid on the origin like the mesh, 'width' & 'height' have to be at least 2
+void heightFieldInit(HeightField* field, const uint32_t* texels, uint32_t width, uint32_t height, float unitHeight);
+// Height at one point, 'normal' may be null
+float heightFieldSample(const HeightField* field, float x, float z, float normal[3]);
+// Heights of 'count' points 4 at a time, large batches are split over every thread.
+// 'normals' may be null, otherwise it receives 'count' x's, then y's, then z's.
+void heightFieldQuery(const HeightField* field, const float* xs, const float* zs, uint32_t count, float* heights, float* normals);
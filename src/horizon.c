@@ -0,0 +1,263 @@
+#include "horizon.h"
+
+#include <glad/glad.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jobs.h"
+
+// Difference in the sine of the elevation over which the sun fades in above the horizon
+#define HORIZON_SUN_SOFTNESS 0.05f
+
+// Direction k looks towards x & z of kDirections[k], 45 degrees apart
+static const int32_t kDirections[HORIZON_DIRECTIONS][2] = {
+    { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+};
+
+// Lines of a column or diagonal direction swept side by side, so each step reads a run of
+// neighbouring texels of one row instead of one texel per row
+#define HORIZON_BLOCK 32
+
+typedef struct {
+    HorizonBake* bake;
+    const uint32_t* heights;
+    uint32_t x0, z0, x1, z1;
+    uint32_t direction;
+    // Lines through the rectangle, rows for +-x & otherwise x - z * dx * dz where they cross z = 0
+    int32_t firstLine, lastLine;
+    // Lowest & highest changed texel of every row
+    uint32_t* changed;
+} BakeJob;
+
+typedef struct {
+    int32_t* steps;
+    float* heights;
+    uint32_t count;
+} Hull;
+
+// Horizon sine of a texel 's' steps from the far end of its line & 'h' high, after dropping
+// the hull points it sees below the next one further out, which can't be the horizon of
+// anything nearer either. Slopes are compared multiplied out as both distances are positive.
+static inline uint8_t hullAdd(Hull* hull, int32_t s, float h, float step) {
+    uint32_t count = hull->count;
+    while(count >= 2 && (hull->heights[count - 1] - h) * (s - hull->steps[count - 2]) <= (hull->heights[count - 2] - h) * (s - hull->steps[count - 1]))
+        count--;
+
+    uint8_t sine = 0;
+    if(count > 0) {
+        float slope = (hull->heights[count - 1] - h) / ((s - hull->steps[count - 1]) * step);
+        if(slope > 0.0f)
+            sine = (uint8_t)(slope / sqrtf(1.0f + slope * slope) * 255.0f + 0.5f);
+    }
+    hull->steps[count] = s;
+    hull->heights[count] = h;
+    hull->count = count + 1;
+    return sine;
+}
+
+// Directions along x, each line is a row
+static void sweepRows(void* user, uint32_t begin, uint32_t end) {
+    const BakeJob* job = user;
+    const HorizonBake* bake = job->bake;
+    int32_t dx = kDirections[job->direction][0];
+    uint8_t* plane = bake->horizons + (size_t)job->direction * bake->width * bake->height;
+
+    Hull hull = { malloc(bake->width * sizeof(int32_t)), malloc(bake->width * sizeof(float)), 0 };
+    if(hull.steps && hull.heights) {
+        for(uint32_t z = job->firstLine + begin; z < job->firstLine + end; z++) {
+            size_t row = (size_t)z * bake->width;
+            hull.count = 0;
+            for(uint32_t s = 0; s < bake->width; s++) {
+                uint32_t x = dx > 0 ? bake->width - 1 - s : s;
+                plane[row + x] = hullAdd(&hull, s, (job->heights[row + x] & 0xff) * bake->unitHeight, bake->spacing);
+            }
+        }
+    }
+    free(hull.steps);
+    free(hull.heights);
+}
+
+// Column & diagonal directions, a block of HORIZON_BLOCK neighbouring lines per item
+static void sweepBlocks(void* user, uint32_t begin, uint32_t end) {
+    const BakeJob* job = user;
+    const HorizonBake* bake = job->bake;
+    int32_t dx = kDirections[job->direction][0], dz = kDirections[job->direction][1];
+    int32_t k = dx * dz;
+    float step = bake->spacing * (dx != 0 ? sqrtf(2.0f) : 1.0f);
+    uint8_t* plane = bake->horizons + (size_t)job->direction * bake->width * bake->height;
+
+    int32_t* steps = malloc((size_t)HORIZON_BLOCK * bake->height * sizeof(int32_t));
+    float* heights = malloc((size_t)HORIZON_BLOCK * bake->height * sizeof(float));
+    Hull hulls[HORIZON_BLOCK];
+    for(uint32_t b = begin; b < end && steps && heights; b++) {
+        int32_t first = job->firstLine + (int32_t)(b * HORIZON_BLOCK);
+        int32_t last = first + HORIZON_BLOCK - 1 < job->lastLine ? first + HORIZON_BLOCK - 1 : job->lastLine;
+        for(int32_t j = 0; j <= last - first; j++)
+            hulls[j] = (Hull){ steps + (size_t)j * bake->height, heights + (size_t)j * bake->height, 0 };
+
+        for(uint32_t s = 0; s < bake->height; s++) {
+            int32_t z = dz > 0 ? (int32_t)bake->height - 1 - (int32_t)s : (int32_t)s;
+            size_t row = (size_t)z * bake->width;
+            // The lines' texels on this row, some may not have entered the grid yet or left it
+            int32_t x0 = first + k * z, x1 = last + k * z;
+            int32_t from = x0 > 0 ? x0 : 0;
+            int32_t to = x1 < (int32_t)bake->width - 1 ? x1 : (int32_t)bake->width - 1;
+            for(int32_t x = from; x <= to; x++)
+                plane[row + x] = hullAdd(&hulls[x - x0], s, (job->heights[row + x] & 0xff) * bake->unitHeight, step);
+        }
+    }
+    free(steps);
+    free(heights);
+}
+
+static void finishRows(void* user, uint32_t begin, uint32_t end) {
+    const BakeJob* job = user;
+    const HorizonBake* bake = job->bake;
+    size_t planeSize = (size_t)bake->width * bake->height;
+    uint32_t sun0 = (uint32_t)bake->sunAzimuth % HORIZON_DIRECTIONS;
+    uint32_t sun1 = (sun0 + 1) % HORIZON_DIRECTIONS;
+    float sunT = bake->sunAzimuth - floorf(bake->sunAzimuth);
+
+    for(uint32_t z = begin; z < end; z++) {
+        // Rows through the rectangle are swept whole, the others only where a column or
+        // diagonal through it crosses them
+        int32_t lo = 0, hi = (int32_t)bake->width - 1;
+        int32_t rz = (int32_t)z;
+        if(z < job->z0 || z > job->z1) {
+            int32_t x0 = job->x0, z0 = job->z0, x1 = job->x1, z1 = job->z1;
+            int32_t from = x0 - z1 + rz < x0 + z0 - rz ? x0 - z1 + rz : x0 + z0 - rz;
+            int32_t to = x1 - z0 + rz > x1 + z1 - rz ? x1 - z0 + rz : x1 + z1 - rz;
+            lo = from > lo ? from : lo;
+            hi = to < hi ? to : hi;
+        }
+
+        uint32_t first = bake->width, last = 0;
+        for(int32_t x = lo; x <= hi; x++) {
+            size_t index = (size_t)z * bake->width + x;
+            uint32_t sum = 0;
+            for(uint32_t k = 0; k < HORIZON_DIRECTIONS; k++)
+                sum += bake->horizons[k * planeSize + index];
+            uint8_t ao = (uint8_t)(255 - (sum + HORIZON_DIRECTIONS / 2) / HORIZON_DIRECTIONS);
+
+            float horizon = (bake->horizons[sun0 * planeSize + index] * (1.0f - sunT) + bake->horizons[sun1 * planeSize + index] * sunT) / 255.0f;
+            float light = (bake->sunSine - horizon) / HORIZON_SUN_SOFTNESS + 0.5f;
+            light = bake->sunSine > 0.0f ? (light < 0.0f ? 0.0f : (light > 1.0f ? 1.0f : light)) : 0.0f;
+            uint8_t sun = (uint8_t)(light * 255.0f + 0.5f);
+
+            uint8_t* texel = bake->texels + 2 * index;
+            if(texel[0] != ao || texel[1] != sun) {
+                texel[0] = ao;
+                texel[1] = sun;
+                first = (uint32_t)x < first ? (uint32_t)x : first;
+                last = (uint32_t)x;
+            }
+        }
+        job->changed[2 * z] = first;
+        job->changed[2 * z + 1] = last;
+    }
+}
+
+bool horizonBakeInit(HorizonBake* bake, uint32_t width, uint32_t height, float spacing, float unitHeight, const float sun[3]) {
+    memset(bake, 0, sizeof(HorizonBake));
+    bake->width = width;
+    bake->height = height;
+    bake->spacing = spacing;
+    bake->unitHeight = unitHeight;
+
+    float length = sqrtf(sun[0] * sun[0] + sun[1] * sun[1] + sun[2] * sun[2]);
+    float azimuth = atan2f(sun[2], sun[0]) / (2.0f * 3.14159265f) * HORIZON_DIRECTIONS;
+    bake->sunAzimuth = azimuth < 0.0f ? azimuth + HORIZON_DIRECTIONS : azimuth;
+    bake->sunSine = length > 0.0f ? sun[1] / length : 0.0f;
+
+    bake->horizons = malloc((size_t)HORIZON_DIRECTIONS * width * height);
+    // Zeroed, the first bake of a new size is uploaded whole anyway
+    bake->texels = calloc((size_t)width * height, 2);
+    if(!bake->horizons || !bake->texels) {
+        horizonBakeDestroy(bake);
+        return false;
+    }
+    bake->dirtyX0 = 1;
+    return true;
+}
+
+void horizonBakeDestroy(HorizonBake* bake) {
+    free(bake->horizons);
+    free(bake->texels);
+    memset(bake, 0, sizeof(HorizonBake));
+}
+
+void horizonBakeUpdate(HorizonBake* bake, const uint32_t* heights, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1) {
+    bake->dirtyX0 = 1;
+    bake->dirtyX1 = 0;
+    if(!bake->horizons || x0 > x1 || z0 > z1 || x0 >= bake->width || z0 >= bake->height)
+        return;
+
+    BakeJob job = {
+        .bake = bake,
+        .heights = heights,
+        .x0 = x0,
+        .z0 = z0,
+        .x1 = x1 < bake->width ? x1 : bake->width - 1,
+        .z1 = z1 < bake->height ? z1 : bake->height - 1,
+        .changed = malloc(2 * (size_t)bake->height * sizeof(uint32_t))
+    };
+    if(!job.changed)
+        return;
+
+    for(uint32_t k = 0; k < HORIZON_DIRECTIONS; k++) {
+        int32_t dx = kDirections[k][0], dz = kDirections[k][1];
+        job.direction = k;
+        if(dz == 0) {
+            job.firstLine = job.z0;
+            job.lastLine = job.z1;
+            jobsParallelFor(job.z1 - job.z0 + 1, 16, sweepRows, &job);
+            continue;
+        }
+        // Where the lines through the rectangle's corners cross z = 0
+        int32_t corners[2] = { (int32_t)job.x0 - dx * dz * (int32_t)job.z0, (int32_t)job.x0 - dx * dz * (int32_t)job.z1 };
+        int32_t spread = (int32_t)(job.x1 - job.x0);
+        job.firstLine = corners[0] < corners[1] ? corners[0] : corners[1];
+        job.lastLine = (corners[0] > corners[1] ? corners[0] : corners[1]) + spread;
+        uint32_t lines = job.lastLine - job.firstLine + 1;
+        jobsParallelFor((lines + HORIZON_BLOCK - 1) / HORIZON_BLOCK, 1, sweepBlocks, &job);
+    }
+    jobsParallelFor(bake->height, 16, finishRows, &job);
+
+    uint32_t dirtyX0 = bake->width, dirtyZ0 = bake->height, dirtyX1 = 0, dirtyZ1 = 0;
+    for(uint32_t z = 0; z < bake->height; z++) {
+        uint32_t first = job.changed[2 * z], last = job.changed[2 * z + 1];
+        if(first > last)
+            continue;
+        dirtyX0 = first < dirtyX0 ? first : dirtyX0;
+        dirtyX1 = last > dirtyX1 ? last : dirtyX1;
+        dirtyZ0 = z < dirtyZ0 ? z : dirtyZ0;
+        dirtyZ1 = z;
+    }
+    free(job.changed);
+    if(dirtyX0 <= dirtyX1) {
+        bake->dirtyX0 = dirtyX0;
+        bake->dirtyZ0 = dirtyZ0;
+        bake->dirtyX1 = dirtyX1;
+        bake->dirtyZ1 = dirtyZ1;
+    }
+}
+
+void horizonBakeUpload(const HorizonBake* bake, bool full) {
+    // RG8 rows aren't 4 byte aligned for odd widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if(full) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, bake->width, bake->height, 0, GL_RG, GL_UNSIGNED_BYTE, bake->texels);
+    } else if(bake->dirtyX0 <= bake->dirtyX1) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, bake->width);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, bake->dirtyX0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, bake->dirtyZ0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, bake->dirtyX0, bake->dirtyZ0, bake->dirtyX1 - bake->dirtyX0 + 1, bake->dirtyZ1 - bake->dirtyZ0 + 1,
+                        GL_RG, GL_UNSIGNED_BYTE, bake->texels);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Horizons of every heightmap texel in HORIZON_DIRECTIONS directions, baked into an RG8
+// texture with ambient occlusion in red & sun visibility in green. Every line of texels in a
+// direction is swept once from its far end, keeping the upper convex hull of the texels
+// already passed, so the highest point ahead of each texel is found in amortized O(1).
+#define HORIZON_DIRECTIONS 8
+
+typedef struct {
+    uint32_t width, height;
+    // Grid units between texels & world units per heightmap unit
+    float spacing, unitHeight;
+    // Azimuth in directions (0 is +x, 1 is +x+z, ...) & sine of the sun's elevation
+    float sunAzimuth, sunSine;
+    // Sine of each texel's horizon angle as 0-255, one plane per direction
+    uint8_t* horizons;
+    // RG8 texels
+    uint8_t* texels;
+    // Texels that changed in the last update, empty when x0 > x1
+    uint32_t dirtyX0, dirtyZ0, dirtyX1, dirtyZ1;
+} HorizonBake;
+
+// 'sun' points towards the sun, it needn't be normalized
+bool horizonBakeInit(HorizonBake* bake, uint32_t width, uint32_t height, float spacing, float unitHeight, const float sun[3]);
+void horizonBakeDestroy(HorizonBake* bake);
+// Re-sweeps every line through the texels [x0, x1] x [z0, z1] of 'heights' (RGBA8 with the
+// height in red) on every thread, only those lines' horizons can have changed. The whole
+// rectangle bakes everything.
+void horizonBakeUpdate(HorizonBake* bake, const uint32_t* heights, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+// Uploads the dirty texels to the bound texture, or all of them as a new image when 'full'
+void horizonBakeUpload(const HorizonBake* bake, bool full);
@@ -0,0 +1,79 @@
+#include "indirect.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <string.h>
+
+#include "common.h"
+
+// glad only loads GL 3.3, the 4.3 entry point is fetched by hand
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+
+typedef void (APIENTRYP MultiDrawElementsIndirectFn)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+static MultiDrawElementsIndirectFn multiDrawElementsIndirect;
+
+static bool hasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for(GLint i = 0; i < count; i++) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if(ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void indirectInit(IndirectDraws* draws, bool enable) {
+    memset(draws, 0, sizeof(IndirectDraws));
+    if(!enable)
+        return;
+
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if(major * 10 + minor < 43 && !hasExtension("GL_ARB_multi_draw_indirect")) {
+        INFO("No multi draw indirect on GL %d.%d, drawing chunks one by one\n", major, minor);
+        return;
+    }
+
+    multiDrawElementsIndirect = (MultiDrawElementsIndirectFn)glfwGetProcAddress("glMultiDrawElementsIndirect");
+    if(!multiDrawElementsIndirect) {
+        ERROR("Couldn't load glMultiDrawElementsIndirect, drawing chunks one by one!\n");
+        return;
+    }
+
+    glGenBuffers(1, &draws->buffer);
+    draws->available = true;
+}
+
+void indirectDestroy(IndirectDraws* draws) {
+    if(draws->buffer)
+        glDeleteBuffers(1, &draws->buffer);
+    memset(draws, 0, sizeof(IndirectDraws));
+}
+
+uint32_t indirectSubmit(IndirectDraws* draws, uint32_t mode, uint32_t indexType, const DrawCommand* commands, uint32_t count) {
+    if(count == 0)
+        return 0;
+
+    if(!draws->available) {
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        for(uint32_t i = 0; i < count; i++) {
+            const DrawCommand* c = &commands[i];
+            glDrawElementsBaseVertex(mode, c->count, indexType, (void*)(c->firstIndex * indexSize), c->baseVertex);
+        }
+        return count;
+    }
+
+    // Orphaned every frame so the driver never waits on last frame's commands
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draws->buffer);
+    if(count > draws->capacity)
+        draws->capacity = count;
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, draws->capacity * sizeof(DrawCommand), 0, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(DrawCommand), commands);
+    multiDrawElementsIndirect(mode, indexType, 0, count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return 1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Submits many ranges of the bound index buffer at once. With GL 4.3 or
+// ARB_multi_draw_indirect the commands go into a buffer drawn by a single
+// glMultiDrawElementsIndirect, otherwise they are drawn one by one.
+
+// Laid out as GL's DrawElementsIndirectCommand, 'firstIndex' counts indices not bytes
+typedef struct {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+} DrawCommand;
+
+typedef struct {
+    // False uses the fallback loop
+    bool available;
+    uint32_t buffer;
+    uint32_t capacity;
+} IndirectDraws;
+
+// 'enable' false always takes the fallback, like a GL 3.3 driver would
+void indirectInit(IndirectDraws* draws, bool enable);
+void indirectDestroy(IndirectDraws* draws);
+// Draws 'count' commands with the bound VAO, returns the number of GL draw calls made
+uint32_t indirectSubmit(IndirectDraws* draws, uint32_t mode, uint32_t indexType, const DrawCommand* commands, uint32_t count);
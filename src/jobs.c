@@ -0,0 +1,161 @@
+#include "jobs.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct {
+    pthread_t threads[JOBS_MAX_THREADS];
+    uint32_t workerCount;
+    bool running;
+
+    pthread_mutex_t submit;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint64_t generation;
+    uint32_t busy;
+    bool quit;
+
+    JobFunc func;
+    void* user;
+    uint32_t count;
+    uint32_t grain;
+    atomic_uint next;
+} Jobs;
+
+static Jobs jobs;
+
+static uint32_t cpuCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t)n : 1;
+#endif
+}
+
+static void runPieces(void) {
+    uint32_t begin;
+    while((begin = atomic_fetch_add(&jobs.next, jobs.grain)) < jobs.count) {
+        uint32_t end = begin + jobs.grain;
+        if(end > jobs.count)
+            end = jobs.count;
+        jobs.func(jobs.user, begin, end);
+    }
+}
+
+static void* workerMain(void* arg) {
+    (void)arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&jobs.lock);
+    while(true) {
+        while(jobs.generation == seen && !jobs.quit)
+            pthread_cond_wait(&jobs.wake, &jobs.lock);
+        if(jobs.quit)
+            break;
+        seen = jobs.generation;
+        pthread_mutex_unlock(&jobs.lock);
+
+        runPieces();
+
+        pthread_mutex_lock(&jobs.lock);
+        if(--jobs.busy == 0)
+            pthread_cond_signal(&jobs.done);
+    }
+    pthread_mutex_unlock(&jobs.lock);
+
+    return 0;
+}
+
+void jobsInit(uint32_t threadCount) {
+    if(jobs.running)
+        return;
+    if(threadCount == 0)
+        threadCount = cpuCount();
+    if(threadCount > JOBS_MAX_THREADS)
+        threadCount = JOBS_MAX_THREADS;
+
+    pthread_mutex_init(&jobs.submit, 0);
+    pthread_mutex_init(&jobs.lock, 0);
+    pthread_cond_init(&jobs.wake, 0);
+    pthread_cond_init(&jobs.done, 0);
+    jobs.generation = 0;
+    jobs.quit = false;
+    jobs.workerCount = 0;
+
+    // The calling thread works too, so it needs one thread less
+    for(uint32_t i = 0; i + 1 < threadCount; i++) {
+        if(pthread_create(&jobs.threads[jobs.workerCount], 0, workerMain, 0) != 0)
+            break;
+        jobs.workerCount++;
+    }
+    jobs.running = true;
+}
+
+void jobsShutdown(void) {
+    if(!jobs.running)
+        return;
+
+    pthread_mutex_lock(&jobs.lock);
+    jobs.quit = true;
+    pthread_cond_broadcast(&jobs.wake);
+    pthread_mutex_unlock(&jobs.lock);
+
+    for(uint32_t i = 0; i < jobs.workerCount; i++)
+        pthread_join(jobs.threads[i], 0);
+
+    pthread_cond_destroy(&jobs.done);
+    pthread_cond_destroy(&jobs.wake);
+    pthread_mutex_destroy(&jobs.lock);
+    pthread_mutex_destroy(&jobs.submit);
+    jobs.workerCount = 0;
+    jobs.running = false;
+}
+
+uint32_t jobsThreadCount(void) {
+    return jobs.workerCount + 1;
+}
+
+void jobsParallelFor(uint32_t count, uint32_t grain, JobFunc func, void* user) {
+    if(count == 0)
+        return;
+    if(grain == 0)
+        grain = 1;
+    if(!jobs.running || jobs.workerCount == 0 || count <= grain) {
+        func(user, 0, count);
+        return;
+    }
+
+    pthread_mutex_lock(&jobs.submit);
+
+    jobs.func = func;
+    jobs.user = user;
+    jobs.count = count;
+    jobs.grain = grain;
+    atomic_store(&jobs.next, 0);
+
+    pthread_mutex_lock(&jobs.lock);
+    jobs.busy = jobs.workerCount;
+    jobs.generation++;
+    pthread_cond_broadcast(&jobs.wake);
+    pthread_mutex_unlock(&jobs.lock);
+
+    runPieces();
+
+    pthread_mutex_lock(&jobs.lock);
+    while(jobs.busy != 0)
+        pthread_cond_wait(&jobs.done, &jobs.lock);
+    pthread_mutex_unlock(&jobs.lock);
+
+    pthread_mutex_unlock(&jobs.submit);
+}
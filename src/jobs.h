@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+#define JOBS_MAX_THREADS 64
+
+// Processes the items [begin, end) of a parallel loop
+typedef void (*JobFunc)(void* user, uint32_t begin, uint32_t end);
+
+// Starts the worker pool, 0 picks one thread per logical core
+void jobsInit(uint32_t threadCount);
+void jobsShutdown(void);
+// Number of threads taking part in a parallel loop, the caller included
+uint32_t jobsThreadCount(void);
+// Splits [0, count) into pieces of 'grain' items and runs them on the pool.
+// Blocks until every piece is done. Calls from different threads are serialized.
+void jobsParallelFor(uint32_t count, uint32_t grain, JobFunc func, void* user);
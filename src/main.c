@@ -9,25 +9,130 @@
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
 
 #include "maths.h"
-
-#define ARR_LEN(arr) (sizeof(arr)/sizeof(arr[0]))
-
-#define INFO(msg, ...) do { fprintf(stdout, "INFO: "); fprintf(stdout, msg, ##__VA_ARGS__); } while(0)
-#define ERROR(msg, ...) do { fprintf(stderr, "ERROR: "); fprintf(stderr, msg, ##__VA_ARGS__); } while(0)
+#include "common.h"
+#include "jobs.h"
+#include "noise.h"
+#include "gpugen.h"
+#include "mesh.h"
+#include "rtin.h"
+#include "qem.h"
+#include "indirect.h"
+#include "tess.h"
+#include "pyramid.h"
+#include "raycast.h"
+#include "heightfield.h"
+#include "viewshed.h"
+#include "horizon.h"
+#include "normalmap.h"
+#include "sculpt.h"
 
 #define OCTAVES 12
 #define MAX_HEIGHT 100
 #define GRID_WIDTH 300 
 #define GRID_HEIGHT 300
 #define TERRAIN_GENERATE_COOLDOWN 1.0
+#define WARP_STRENGTH 0.0f
+#define WARP_OCTAVES 4
+#define NOISE_BACKEND "perlin"
+#define CELL_WEIGHT 0.0f
+#define PROGRESSIVE_FIRST_SIZE 64
+#define PROGRESSIVE_FIRST_OCTAVES 3
+#define PROGRESSIVE_MAX_PASSES 8
+// Grid units to noise space
+#define NOISE_SCALE 0.025f
+#define VERTEX_FORMAT "packed"
+#define MESH_LAYOUT "strip"
+// Quads per side of a tessellation patch & the edge length in pixels the GPU subdivides towards
+#define TESS_PATCH_SIZE 64
+#define TESS_PIXELS 8.0f
+// Quads per side of the shared patch of the instanced terrain
+#define PATCH_SIZE 64
+// Height error in world units of exported meshes when no triangle count is given
+#define EXPORT_ERROR 0.25f
+// Camera simulation ticks per second, its speed in units per second & how high above the
+// terrain walk mode keeps it. Frames longer than CAMERA_MAX_FRAME_TIME are simulated as that
+// long so a stall doesn't turn into a burst of ticks.
+#define CAMERA_TICK_RATE 120
+#define CAMERA_SPEED 20.0f
+#define CAMERA_EYE_HEIGHT 2.0f
+#define CAMERA_MAX_FRAME_TIME 0.25
+// Position of the light, far enough away to light the terrain like the sun the horizon bake assumes
+#define LIGHT_POS 1000.0f, 1000.0f, 0.0f
+// Sky light on top of the ambient term, scaled by the baked ambient occlusion
+#define SKY_LIGHT 0.15f
+// World units above the ground of the eye & of the targets of the viewshed overlay
+#define VIEWSHED_OBSERVER_HEIGHT 2.0f
+#define VIEWSHED_TARGET_HEIGHT 0.0f
+// Sculpting brush radius in grid units & heightmap units per second at its centre
+#define BRUSH_RADIUS 16.0f
+#define BRUSH_STRENGTH 60.0f
+// Post-transform cache entries the index order is tuned for, 16 is safe on old & new GPUs alike
+#define VERTEX_CACHE_SIZE 16
+
+typedef enum {
+    // x, y, z as floats, 12 bytes
+    VERTEX_FORMAT_FLOAT,
+    // 16 bit grid x, height & grid z, 6 bytes
+    VERTEX_FORMAT_PACKED,
+    // Packed plus a hemi-octahedral 2x8 bit normal, 8 bytes
+    VERTEX_FORMAT_PACKED_NORMAL,
+    // Packed with a zero height, the shared patch of 'instanced=1'
+    VERTEX_FORMAT_PATCH
+} VertexFormat;
+
+typedef struct {
+    uint16_t x, height, z;
+} PackedVertex;
+
+typedef struct {
+    uint16_t x, height, z;
+    int8_t normal[2];
+} PackedNormalVertex;
+
+// Where a patch goes, its first vertex & the grid units between its vertices
+typedef struct {
+    float x, z, scale;
+} PatchInstance;
 
 typedef struct {
     int octaves;
     int maxHeight;
     int gridWidth, gridHeight;
     double terrainGenCooldown;
+    int threads;
+    const char* noise;
+    const char* noiseFile;
+    float warpStrength;
+    int warpOctaves;
+    const char* noiseBackend;
+    float cellWeight;
+    bool fixedPoint;
+    int seed;
+    bool progressive;
+    bool compute;
+    VertexFormat vertexFormat;
+    MeshLayout meshLayout;
+    int vertexCacheSize;
+    float rtinError;
+    float lodDistance;
+    bool indirect;
+    bool instanced;
+    bool tessellation;
+    float tessPixels;
+    bool walk;
+    bool bake;
+    bool normalMap;
+    float brushRadius;
+    float brushStrength;
+    const char* exportPath;
+    int exportTriangles;
+    float exportError;
+    bool benchmark;
 } Settings;
 
 typedef struct {
@@ -39,7 +144,14 @@ typedef struct {
     float yaw;
     float pitch;
     float sensitivity;
+    // Units per second
     float speed;
+    // Kept above the terrain while set, 'F' toggles it
+    bool walk;
+    // Simulation time not yet ticked & the position before the last tick, rendering
+    // interpolates between it & 'pos' by how far into the next tick the frame is
+    double accumulator;
+    Vec3 prevPos;
 
     Vec3 pos;
     Vec3 front;
@@ -50,6 +162,109 @@ typedef struct {
     Mat4 view;
 } Camera;
 
+typedef enum {
+    CAMERA_MOVE_FORWARD = 1,
+    CAMERA_MOVE_BACK = 2,
+    CAMERA_MOVE_LEFT = 4,
+    CAMERA_MOVE_RIGHT = 8,
+    CAMERA_MOVE_UP = 16,
+    CAMERA_MOVE_DOWN = 32
+} CameraMove;
+
+// Everything a simulation tick depends on besides the camera itself, so recording these
+// per tick replays the exact same path whatever the frame rate was
+typedef struct {
+    uint32_t moves;
+    float yaw, pitch;
+} CameraInput;
+
+typedef struct {
+    // Only every step-th grid point is generated, with at most 'octaves' octaves
+    uint32_t step;
+    int octaves;
+} GenPass;
+
+// A generated pass with the lighting baked from it, all built on the thread that generated it
+// so the render thread only has to upload them
+typedef struct {
+    uint32_t* data;
+    // Each zeroed when it is off or failed, the normal map is only built for the final pass
+    HorizonBake bake;
+    NormalMap normalMap;
+} PassResult;
+
+// Refines the terrain on a background thread, pass by pass
+typedef struct {
+    pthread_t thread;
+    bool running;
+    atomic_bool cancel;
+    pthread_mutex_t lock;
+
+    NoiseProgram program;
+    NoiseWarp warp;
+    int seed;
+    uint32_t gridWidth, gridHeight;
+    GenPass passes[PROGRESSIVE_MAX_PASSES];
+    uint32_t passCount;
+    bool bake, normalMap;
+    float unitHeight;
+
+    // Newest finished pass that the render thread hasn't taken yet, no data when there is none
+    PassResult result;
+    uint32_t resultPass;
+} Generator;
+
+// The adaptive mesh's triangles & vertices before they are uploaded
+typedef struct {
+    RtinMesh mesh;
+    VertexFormat format;
+    uint8_t* vertices;
+    size_t vertexBytes;
+} AdaptiveMesh;
+
+// Catches the horizon bake & the adaptive mesh up with a finished stroke on a background
+// thread. Sculpting waits for it, nothing else writes the heights while it reads them.
+typedef struct {
+    pthread_t thread;
+    bool running;
+    atomic_bool done;
+
+    DirtyRect rect;
+    // The bake is re-swept in place, the render thread leaves its texels alone until 'done'
+    bool bake;
+    // The error tree & its mesh at 'rtinError' are built apart from the ones being drawn and
+    // swapped in once 'done'
+    bool rebuildRtin, rtinBuilt;
+    float rtinError;
+    RtinTree rtin;
+    AdaptiveMesh mesh;
+    double time;
+} StrokeCatchUp;
+
+// A chunk of the mesh, drawn with 16 bit indices from the shared index buffer
+typedef struct {
+    int32_t baseVertex;
+    size_t indexOffset;
+    uint32_t count;
+    // Index sets & world space bounds (xz) of grid chunks, picked from every frame with LOD
+    uint32_t shape;
+    uint32_t level;
+    float centerX, centerZ;
+    float extentX, extentZ;
+    // Height bounds, from the heightmap's pyramid when the mesh was built from heights
+    float centerY, extentY;
+    // Heightmap samples the chunk's vertices were built from, row by row
+    MeshChunk grid;
+} TerrainChunk;
+
+// Indices shared by every chunk of one size. Each detail level holds its
+// MESH_STITCH_VARIANTS variants back to back, indexed by their MeshEdge mask.
+typedef struct {
+    uint32_t width, height;
+    size_t offsets[MESH_LOD_LEVELS];
+    uint32_t counts[MESH_LOD_LEVELS];
+} TerrainShape;
+
 typedef struct {
     Settings settings;
 
@@ -64,9 +279,76 @@ typedef struct {
     uint32_t shader;
     uint32_t vao, vbo, ebo;
     uint32_t tex;
+    // Indices drawn over all chunks & the size of the shared index buffer
     uint32_t count;
+    size_t indexBytes;
+    TerrainChunk* chunks;
+    uint32_t chunkCount;
+    // Chunks are stored row by row, 'lodLevels' is 1 without LOD
+    uint32_t chunksX, chunksY;
+    TerrainShape shapes[4];
+    uint32_t shapeCount;
+    uint32_t lodLevels;
+    // Commands of the chunks that survived culling this frame, the GL draw
+    // calls they took & the CPU time spent submitting them
+    IndirectDraws indirect;
+    DrawCommand* drawCommands;
+    // With the instanced terrain, every patch's instance & the visible ones
+    // streamed to 'instanceVbo' each frame, the step the patches were made for
+    PatchInstance* patches;
+    PatchInstance* instances;
+    uint32_t instanceVbo;
+    uint32_t patchStep;
+    uint32_t drawCount;
+    uint32_t drawCalls;
+    double submitTime;
+    // Replaces the mesh while 'useTess' is set, 'T' toggles it
+    Tess tess;
+    bool useTess;
+    // GL_UNSIGNED_SHORT for the chunked grid, GL_UNSIGNED_INT for the adaptive mesh
+    uint32_t indexType;
+    // Error tree of the full resolution heights for the adaptive mesh,
+    // the threshold can change without rebuilding it
+    RtinTree rtin;
+    const uint32_t* rtinHeights;
+    float rtinError;
+    // Format of the current mesh, the setting can't be used for meshes without heights
+    VertexFormat vertexFormat;
+    MeshLayout meshLayout;
     
+    NoiseProgram program;
+    NoiseWarp warp;
+    Generator gen;
+    GpuGen gpuGen;
+    // Set once 'export' has been written, regenerating doesn't overwrite it
+    bool exported;
+    // Full resolution heightmap, only set once the final pass is done.
+    // Stays null when the compute shader writes the texture directly.
     uint32_t* data;
+    // Min/max quadtree of 'data' for picking & line of sight queries
+    HeightTree heightTree;
+    // R8 mask of the grid points seen from the last observer, shaded over the terrain while
+    // 'showViewshed' is set. 'V' places the observer, a new heightmap hides it.
+    uint32_t viewshedTex;
+    bool showViewshed;
+    // Ambient occlusion & sun shadows of the last heightmap on the CPU, 'bakeTex' holds them
+    // for the shader while 'useBake' is set
+    HorizonBake bake;
+    uint32_t bakeTex;
+    bool useBake;
+    // Per texel normals of the last heightmap on the CPU, shaded per fragment from 'normalTex'
+    // instead of the vertex shader's central differences while 'useNormalMap' is set
+    NormalMap normalMap;
+    uint32_t normalTex;
+    bool useNormalMap;
+    // Sculpting, 'E' dabs 'brush' on the terrain under the cursor every frame. 'editRect' holds
+    // the texels changed since the last upload, 'strokeRect' those of the whole stroke for the
+    // horizon bake & the adaptive mesh, which only catch up on 'catchUp' once it ends.
+    SculptBrush brush;
+    DirtyRect editRect, strokeRect;
+    uint32_t strokeDabs;
+    double strokeUpload;
+    StrokeCatchUp catchUp;
 } Ctx;
 
 char* readFile(const char* path) {
@@ -93,37 +375,184 @@ uint32_t rgbToInt(uint8_t r, uint8_t b, uint8_t g) {
     return (uint32_t)((0xFF << 24) | (b << 16) | (g << 8) | r);
 }
 
-float getPerlin2D(float x, float y, int octaves, int seed) {
-    float v = 0.0f;
-    float amplitude = 1.0f;
-    float frequency = 1.0f;
-    float max = 0.0f;
+typedef struct {
+    const NoiseProgram* program;
+    const NoiseWarp* warp;
+    int seed;
+    float scale;
+    uint32_t step;
+    uint32_t width, height;
+    uint32_t tilesX;
+    uint32_t* data;
+    const atomic_bool* cancel;
+} HeightJob;
+
+void getHeightTiles(void* user, uint32_t begin, uint32_t end) {
+    const HeightJob* job = user;
+    float xs[NOISE_TILE_SIZE], ys[NOISE_TILE_SIZE], noise[NOISE_TILE_SIZE];
+
+    for(uint32_t t = begin; t < end; t++) {
+        if(job->cancel && atomic_load_explicit(job->cancel, memory_order_relaxed))
+            return;
+        uint32_t x0 = (t % job->tilesX) * NOISE_TILE_DIM;
+        uint32_t y0 = (t / job->tilesX) * NOISE_TILE_DIM;
+        uint32_t w = job->width - x0 < NOISE_TILE_DIM ? job->width - x0 : NOISE_TILE_DIM;
+        uint32_t h = job->height - y0 < NOISE_TILE_DIM ? job->height - y0 : NOISE_TILE_DIM;
+
+        if(job->program->fixedPoint) {
+            int32_t gx[NOISE_TILE_SIZE], gy[NOISE_TILE_SIZE];
+            uint8_t heights[NOISE_TILE_SIZE];
+            uint32_t n = 0;
+            for(uint32_t y = 0; y < h; y++) {
+                for(uint32_t x = 0; x < w; x++) {
+                    gx[n] = (x0 + x) * job->step;
+                    gy[n] = (y0 + y) * job->step;
+                    n++;
+                }
+            }
+
+            noiseFixedTile(job->program->fixedOctaves, job->seed, gx, gy, n, heights);
+
+            n = 0;
+            for(uint32_t y = 0; y < h; y++) {
+                for(uint32_t x = 0; x < w; x++) {
+                    uint8_t v = heights[n++];
+                    job->data[(y0 + y) * job->width + x0 + x] = rgbToInt(v, v, v);
+                }
+            }
+            continue;
+        }
+
+        uint32_t n = 0;
+        for(uint32_t y = 0; y < h; y++) {
+            for(uint32_t x = 0; x < w; x++) {
+                xs[n] = ((x0 + x) * job->step) * job->scale;
+                ys[n] = ((y0 + y) * job->step) * job->scale;
+                n++;
+            }
+        }
+
+        noiseWarpTile(job->warp, job->seed, xs, ys, n);
+        noiseEvalTile(job->program, job->seed, xs, ys, n, noise);
+
+        n = 0;
+        for(uint32_t y = 0; y < h; y++) {
+            for(uint32_t x = 0; x < w; x++) {
+                float v = noise[n++];
+                v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+                v = v * 0.5f + 0.5f;
+                v *= 255;
+
+                job->data[(y0 + y) * job->width + x0 + x] = rgbToInt(v, v, v);
+            }
+        }
+    }
+}
+
+// Generates a width x height heightmap of the grid points (x * step, y * step). Setting 'cancel'
+// (optional) stops every thread at its next tile and leaves the rest of 'data' unwritten.
+void getHeight(const NoiseProgram* program, const NoiseWarp* warp, int seed, uint32_t step, uint32_t width, uint32_t height, uint32_t* data, const atomic_bool* cancel) {
+    HeightJob job = {
+        .program = program,
+        .warp = warp,
+        .seed = seed,
+        .scale = NOISE_SCALE,
+        .step = step,
+        .width = width,
+        .height = height,
+        .tilesX = (width + NOISE_TILE_DIM - 1) / NOISE_TILE_DIM,
+        .data = data,
+        .cancel = cancel
+    };
+    uint32_t tiles = job.tilesX * ((height + NOISE_TILE_DIM - 1) / NOISE_TILE_DIM);
+
+    jobsParallelFor(tiles, 4, getHeightTiles, &job);
+}
 
-    for(int i = 0; i < octaves; i++) {
-        v += stb_perlin_noise3_seed(x * frequency, 0, y * frequency, 0, 0, 0, seed) * amplitude;
-        max += amplitude;
-        frequency *= 2.0f;
-        amplitude *= 0.5f;
+// FNV-1a of the heights, equal on every machine when the fixed point path is used
+uint64_t hashHeightmap(const uint32_t* data, size_t count) {
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < count; i++) {
+        hash ^= data[i] & 0xff;
+        hash *= 1099511628211ull;
     }
-    
-    return v/max;
+    return hash;
 }
 
-void getHeight(uint32_t octaves, uint32_t width, uint32_t height, uint32_t* data) {
-    size_t size = width * height;
+int nextSeed(const Settings* settings) {
+    return settings->seed >= 0 ? settings->seed : (int)time(0);
+}
 
-    int seed = time(0);
+void defaultNoiseGraph(const Settings* settings, char* graph, size_t size) {
+    if(settings->cellWeight > 0.0f)
+        snprintf(graph, size, "add(fbm(%d), mul(remap(cells(0.5), 0, 1, -1, 1), %g))", settings->octaves, settings->cellWeight);
+    else
+        snprintf(graph, size, "fbm(%d)", settings->octaves);
+}
 
-    float scale = 0.025f;
-    for(uint32_t y = 0; y < height; y++) {
-        for(uint32_t x = 0; x < width; x++) {
-            float noise = getPerlin2D(x * scale, y * scale, octaves, seed);
-            noise = noise * 0.5f + 0.5f;
-            noise *= 255;
+bool createNoiseProgram(Ctx* ctx) {
+    char defaultGraph[128];
+    char* file = 0;
+    const char* src = ctx->settings.noise;
 
-            data[y * width + x] = rgbToInt(noise, noise, noise);
+    if(ctx->settings.noiseFile) {
+        FILE* f = fopen(ctx->settings.noiseFile, "rt");
+        if(!f) {
+            ERROR("Can't read file :- %s\n", ctx->settings.noiseFile);
+            return false;
         }
+        fclose(f);
+        file = readFile(ctx->settings.noiseFile);
+        src = file;
+    }
+    if(!src) {
+        defaultNoiseGraph(&ctx->settings, defaultGraph, sizeof(defaultGraph));
+        src = defaultGraph;
+    }
+
+    ctx->warp.strength = ctx->settings.warpStrength;
+    ctx->warp.octaves = ctx->settings.warpOctaves;
+
+    const NoiseBackend* backend = noiseFindBackend(ctx->settings.noiseBackend);
+    if(!backend) {
+        ERROR("Unknown noise backend :- %s\n", ctx->settings.noiseBackend);
+        free(file);
+        return false;
+    }
+
+    bool ok = noiseCompile(src, ctx->settings.octaves, backend, &ctx->program);
+    free(file);
+
+    if(ok && ctx->settings.fixedPoint) {
+        if(ctx->settings.noise || ctx->settings.noiseFile || ctx->settings.warpStrength != 0.0f || ctx->settings.cellWeight != 0.0f)
+            ERROR("The fixed point path only supports the default fbm, ignoring the noise graph, warp & cells!\n");
+        ctx->program.fixedPoint = true;
+        ctx->program.fixedOctaves = ctx->settings.octaves < 32 ? ctx->settings.octaves : 31;
+        ctx->warp.strength = 0.0f;
+    }
+    return ok;
+}
+
+// Builds the tessellation path when asked for, the mesh stays as the fallback
+void createTess(Ctx* ctx) {
+    if(!ctx->settings.tessellation)
+        return;
+
+    const char* files[4] = { "shaders/default.vert", "shaders/terrain.tesc", "shaders/terrain.tese", "shaders/default.frag" };
+    char* sources[4];
+    for(uint32_t i = 0; i < 4; i++)
+        sources[i] = readFile(files[i]);
+    bool ok = tessInit(&ctx->tess, sources[0], sources[1], sources[2], sources[3]);
+    for(uint32_t i = 0; i < 4; i++)
+        free(sources[i]);
+
+    if(!ok) {
+        ERROR("Falling back to drawing the mesh!\n");
+        ctx->useTess = false;
+        return;
     }
+    tessBuildPatches(&ctx->tess, ctx->settings.gridWidth, ctx->settings.gridHeight, TESS_PATCH_SIZE);
+    ctx->useTess = true;
 }
 
 bool createShader(Ctx* ctx, uint32_t* id) {
@@ -192,10 +621,13 @@ void createCamera(Ctx* ctx) {
     ctx->camera.lastY = (float)ctx->height/2;
     ctx->camera.yaw = -90.0f;
     ctx->camera.pitch = 0.0f;
-    ctx->camera.speed = 0.01f;
+    ctx->camera.speed = CAMERA_SPEED;
+    ctx->camera.walk = ctx->settings.walk;
+    ctx->camera.accumulator = 0.0;
     ctx->camera.sensitivity = 0.05f;
 
     ctx->camera.pos = vec3Create(0, 100, 3);
+    ctx->camera.prevPos = ctx->camera.pos;
     ctx->camera.front = vec3Create(0, 0, -1);    
     ctx->camera.up = vec3Create(0, 1, 0);
     ctx->camera.right = vec3Normalize(vec3Cross(ctx->camera.up, ctx->camera.front));
@@ -204,34 +636,71 @@ void createCamera(Ctx* ctx) {
     ctx->camera.view = mat4LookAt(ctx->camera.pos, vec3Add(ctx->camera.pos, ctx->camera.front), ctx->camera.up);
 }
 
-void updateCamera(Ctx* ctx) {
-    bool moved = false;
+// Height queries on the full resolution heightmap in world units, false until it's on the CPU
+bool terrainHeightField(const Ctx* ctx, HeightField* field) {
+    if(!ctx->data)
+        return false;
+    heightFieldInit(field, ctx->data, ctx->settings.gridWidth, ctx->settings.gridHeight, (float)ctx->settings.maxHeight / 255.0f);
+    return true;
+}
+
+Vec3 cameraFront(float yaw, float pitch) {
+    Vec3 front;
+    front.x = cos(yaw * DEG2RAD_MULTIPLIER) * cos(pitch * DEG2RAD_MULTIPLIER);
+    front.y = sin(pitch * DEG2RAD_MULTIPLIER);
+    front.z = sin(yaw * DEG2RAD_MULTIPLIER) * cos(pitch * DEG2RAD_MULTIPLIER);
+    return vec3Normalize(front);
+}
 
+// One fixed step of 1 / CAMERA_TICK_RATE seconds, 'ground' is only given in walk mode
+void cameraTick(Camera* camera, const CameraInput* input, const HeightField* ground) {
+    camera->prevPos = camera->pos;
+
+    Vec3 front = cameraFront(input->yaw, input->pitch);
+    Vec3 right = vec3Normalize(vec3Cross(vec3Create(0, 1, 0), front));
+    Vec3 up = vec3Normalize(vec3Cross(front, right));
+    Vec3 move = vec3Create(0, 0, 0);
+    if(input->moves & CAMERA_MOVE_FORWARD)
+        move = vec3Add(move, front);
+    if(input->moves & CAMERA_MOVE_BACK)
+        move = vec3Sub(move, front);
+    if(input->moves & CAMERA_MOVE_LEFT)
+        move = vec3Add(move, right);
+    if(input->moves & CAMERA_MOVE_RIGHT)
+        move = vec3Sub(move, right);
+    if(input->moves & CAMERA_MOVE_UP)
+        move = vec3Add(move, up);
+    if(input->moves & CAMERA_MOVE_DOWN)
+        move = vec3Sub(move, up);
+    camera->pos = vec3Add(camera->pos, vec3MulScalar(move, camera->speed / CAMERA_TICK_RATE));
+
+    if(ground) {
+        float floor = heightFieldSample(ground, camera->pos.x, camera->pos.z, 0) + CAMERA_EYE_HEIGHT;
+        if(camera->pos.y < floor)
+            camera->pos.y = floor;
+    }
+}
+
+// Adds a frame's time to the camera's & takes as many whole ticks out of it as fit
+uint32_t cameraSteps(Camera* camera, double frameTime) {
+    double tick = 1.0 / CAMERA_TICK_RATE;
+    camera->accumulator += frameTime < CAMERA_MAX_FRAME_TIME ? frameTime : CAMERA_MAX_FRAME_TIME;
+    uint32_t steps = 0;
+    while(camera->accumulator >= tick) {
+        camera->accumulator -= tick;
+        steps++;
+    }
+    return steps;
+}
+
+void updateCamera(Ctx* ctx) {
     //Key Input
+    CameraInput input = { 0 };
     {
-        if(glfwGetKey(ctx->window, GLFW_KEY_W) == GLFW_PRESS) {
-            ctx->camera.pos = vec3Add(ctx->camera.pos, vec3MulScalar(ctx->camera.front, ctx->camera.speed));
-            moved = true;
-        }
-        if(glfwGetKey(ctx->window, GLFW_KEY_S) == GLFW_PRESS) {
-            ctx->camera.pos = vec3Sub(ctx->camera.pos, vec3MulScalar(ctx->camera.front, ctx->camera.speed));
-            moved = true;
-        }
-        if(glfwGetKey(ctx->window, GLFW_KEY_A) == GLFW_PRESS) {
-            ctx->camera.pos = vec3Add(ctx->camera.pos, vec3MulScalar(ctx->camera.right, ctx->camera.speed));
-            moved = true;
-        }
-        if(glfwGetKey(ctx->window, GLFW_KEY_D) == GLFW_PRESS) {
-            ctx->camera.pos = vec3Sub(ctx->camera.pos, vec3MulScalar(ctx->camera.right, ctx->camera.speed));
-            moved = true;
-        }
-        if(glfwGetKey(ctx->window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-            ctx->camera.pos = vec3Add(ctx->camera.pos, vec3MulScalar(ctx->camera.up, ctx->camera.speed));
-            moved = true;
-        }
-        if(glfwGetKey(ctx->window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
-            ctx->camera.pos = vec3Sub(ctx->camera.pos, vec3MulScalar(ctx->camera.up, ctx->camera.speed));
-            moved = true;
+        int keys[6] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE, GLFW_KEY_LEFT_SHIFT };
+        for(uint32_t i = 0; i < 6; i++) {
+            if(glfwGetKey(ctx->window, keys[i]) == GLFW_PRESS)
+                input.moves |= 1u << i;
         }
     }
 
@@ -266,14 +735,7 @@ void updateCamera(Ctx* ctx) {
                 if(ctx->camera.pitch < -89.9f)
                     ctx->camera.pitch = -89.9f;
 
-                Vec3 front;
-                front.x = cos(ctx->camera.yaw * DEG2RAD_MULTIPLIER) * cos(ctx->camera.pitch * DEG2RAD_MULTIPLIER);
-                front.y = sin(ctx->camera.pitch * DEG2RAD_MULTIPLIER);
-                front.z = sin(ctx->camera.yaw * DEG2RAD_MULTIPLIER) * cos(ctx->camera.pitch * DEG2RAD_MULTIPLIER);
-                
-                ctx->camera.front = vec3Normalize(front);
-
-                moved = true;
+                ctx->camera.front = cameraFront(ctx->camera.yaw, ctx->camera.pitch);
             }
         }
         else if(glfwGetMouseButton(ctx->window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_RELEASE) {
@@ -281,62 +743,125 @@ void updateCamera(Ctx* ctx) {
             ctx->camera.firstMouse = true;
         }
     }
+    // Fixed step simulation, looking around stays per frame so it never lags behind the mouse
+    {
+        input.yaw = ctx->camera.yaw;
+        input.pitch = ctx->camera.pitch;
+        HeightField ground;
+        bool walking = ctx->camera.walk && terrainHeightField(ctx, &ground);
+        for(uint32_t steps = cameraSteps(&ctx->camera, ctx->deltaTime); steps > 0; steps--)
+            cameraTick(&ctx->camera, &input, walking ? &ground : 0);
+    }
     // Updating matrices
     {
         ctx->camera.right = vec3Normalize(vec3Cross(vec3Create(0, 1, 0), ctx->camera.front));
         ctx->camera.up = vec3Normalize(vec3Cross(ctx->camera.front, ctx->camera.right));
 
-        if(!moved)
-            return;
-        
+        float alpha = (float)(ctx->camera.accumulator * CAMERA_TICK_RATE);
+        Vec3 eye = vec3Add(ctx->camera.prevPos, vec3MulScalar(vec3Sub(ctx->camera.pos, ctx->camera.prevPos), alpha));
         ctx->camera.proj = mat4Perspective(ctx->camera.fov * DEG2RAD_MULTIPLIER, ctx->camera.aspectRatio, 0.01f, 1000.0f);
-        ctx->camera.view = mat4LookAt(ctx->camera.pos, vec3Add(ctx->camera.pos, ctx->camera.front), ctx->camera.up);
+        ctx->camera.view = mat4LookAt(eye, vec3Add(eye, ctx->camera.front), ctx->camera.up);
     }
 }
 
-void createTerrain(Ctx* ctx) {
-    size_t size = ctx->settings.gridHeight * ctx->settings.gridWidth * 3 * sizeof(float);
-    float* data = malloc(size);
-    memset(data, 0, size);
-    int idx = 0;
-    for(uint32_t y = 0; y < ctx->settings.gridHeight; y++) {
-        for(uint32_t x = 0; x < ctx->settings.gridWidth; x++) {
-            float x1 = (x - (ctx->settings.gridWidth - 1)/2.0f);
-            float z1 = (y - (ctx->settings.gridHeight - 1)/2.0f);
-            
-            uint32_t noise = ctx->data[y * ctx->settings.gridWidth + x] & 0xff;
-            float y1 = noise / 255.0f;
-            y1 *= ctx->settings.maxHeight;
+uint8_t packSnorm8(float v) {
+    v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+    return (uint8_t)(int8_t)lroundf(v * 127.0f);
+}
 
-            data[idx++] = x1;
-            data[idx++] = y1;
-            data[idx++] = z1;
-        }
-    }
+// Same central differences as default.vert, 'step' is the distance between samples in grid units
+void packNormal(const uint32_t* heights, uint32_t width, uint32_t height, uint32_t x, uint32_t y, float unitHeight, float step, int8_t* out) {
+    uint32_t xl = x > 0 ? x - 1 : x, xr = x + 1 < width ? x + 1 : x;
+    uint32_t yd = y > 0 ? y - 1 : y, yu = y + 1 < height ? y + 1 : y;
+    float L = (heights[y * width + xl] & 0xff) * unitHeight;
+    float R = (heights[y * width + xr] & 0xff) * unitHeight;
+    float D = (heights[yd * width + x] & 0xff) * unitHeight;
+    float U = (heights[yu * width + x] & 0xff) * unitHeight;
+
+    // cross((0, U - D, 2), (2, R - L, 0)) scaled by 1/2, y always points up
+    float nx = -(R - L) / step;
+    float ny = 2.0f;
+    float nz = -(U - D) / step;
+
+    // Projected onto the upper half of the octahedron, y is 1 - |x| - |z|
+    float sum = fabsf(nx) + ny + fabsf(nz);
+    out[0] = (int8_t)packSnorm8(nx / sum);
+    out[1] = (int8_t)packSnorm8(nz / sum);
+}
+
+VertexFormat meshVertexFormat(const Ctx* ctx, const uint32_t* heights) {
+    // The packed formats' 16 bit grid coordinates would wrap on larger grids
+    if(ctx->settings.gridWidth > 65536 || ctx->settings.gridHeight > 65536)
+        return VERTEX_FORMAT_FLOAT;
+    // Without heights the vertex shader displaces the mesh from the texture,
+    // there is nothing to bake a normal from
+    if(ctx->settings.vertexFormat == VERTEX_FORMAT_PACKED_NORMAL && !heights)
+        return VERTEX_FORMAT_PACKED;
+    return ctx->settings.vertexFormat;
+}
 
-    uint32_t indicesLen = (ctx->settings.gridWidth - 1) * (ctx->settings.gridHeight - 1) * 6;
-    ctx->count = indicesLen;
-    uint32_t* indices = malloc(indicesLen * sizeof(uint32_t));
-    memset(indices, 0, indicesLen * sizeof(uint32_t));
+size_t vertexStride(VertexFormat format) {
+    return format == VERTEX_FORMAT_FLOAT ? 3 * sizeof(float) :
+           (format == VERTEX_FORMAT_PACKED_NORMAL ? sizeof(PackedNormalVertex) : sizeof(PackedVertex));
+}
+
+// Writes the vertex of the sample (x, y) of a width x height heightmap
+void writeVertex(const Ctx* ctx, VertexFormat format, const uint32_t* heights, uint32_t width, uint32_t height, uint32_t step, uint32_t x, uint32_t y, uint8_t* v) {
+    uint32_t gridWidth = (uint32_t)ctx->settings.gridWidth, gridHeight = (uint32_t)ctx->settings.gridHeight;
+    uint32_t gx = x * step < gridWidth ? x * step : gridWidth - 1;
+    uint32_t gy = y * step < gridHeight ? y * step : gridHeight - 1;
+    uint32_t noise = heights ? heights[y * width + x] & 0xff : 0;
+
+    if(format == VERTEX_FORMAT_FLOAT) {
+        float* f = (float*)v;
+        f[0] = (gx - (ctx->settings.gridWidth - 1)/2.0f);
+        f[1] = noise / 255.0f * ctx->settings.maxHeight;
+        f[2] = (gy - (ctx->settings.gridHeight - 1)/2.0f);
+        return;
+    }
 
-    idx = 0;
-    for(uint32_t y = 0; y < ctx->settings.gridHeight-1; y++) {
-        for(uint32_t x = 0; x < ctx->settings.gridWidth-1; x++) {
-            uint32_t v0 = y * ctx->settings.gridWidth + x;
-            uint32_t v1 = y * ctx->settings.gridWidth + (x + 1);
-            uint32_t v2 = (y+1) * ctx->settings.gridWidth + x;
-            uint32_t v3 = (y+1) * ctx->settings.gridWidth + (x+1);
+    // Heights are bytes so *257 maps them exactly onto the 16 bit range
+    PackedVertex packed = { (uint16_t)gx, (uint16_t)(noise * 257), (uint16_t)gy };
+    if(format == VERTEX_FORMAT_PACKED) {
+        memcpy(v, &packed, sizeof(packed));
+    } else {
+        PackedNormalVertex* n = (PackedNormalVertex*)v;
+        n->x = packed.x;
+        n->height = packed.height;
+        n->z = packed.z;
+        packNormal(heights, width, height, x, y, (float)ctx->settings.maxHeight / 255.0f, (float)step, n->normal);
+    }
+}
 
-            indices[idx++] = v0;
-            indices[idx++] = v2;
-            indices[idx++] = v1;
-            
-            indices[idx++] = v1;
-            indices[idx++] = v2;
-            indices[idx++] = v3;
+// Fills a vertex buffer in the configured format, chunk after chunk. Its size in bytes goes to 'size'.
+void* buildVertices(Ctx* ctx, const uint32_t* heights, uint32_t width, uint32_t height, uint32_t step, const MeshChunk* chunks, uint32_t chunkCount, size_t* size) {
+    VertexFormat format = meshVertexFormat(ctx, heights);
+    size_t stride = vertexStride(format);
+    size_t vertices = 0;
+    for(uint32_t c = 0; c < chunkCount; c++)
+        vertices += chunks[c].width * chunks[c].height;
+    *size = vertices * stride;
+    uint8_t* data = malloc(*size);
+    memset(data, 0, *size);
+
+    uint8_t* v = data;
+    for(uint32_t c = 0; c < chunkCount; c++) {
+        for(uint32_t y = chunks[c].y; y < chunks[c].y + chunks[c].height; y++) {
+            for(uint32_t x = chunks[c].x; x < chunks[c].x + chunks[c].width; x++, v += stride)
+                writeVertex(ctx, format, heights, width, height, step, x, y, v);
         }
     }
 
+    ctx->vertexFormat = format;
+    return data;
+}
+
+// Widest stripe whose two vertex rows fit in the cache, 0 walks whole rows
+uint32_t meshStripe(const Settings* settings) {
+    return settings->vertexCacheSize >= 4 ? settings->vertexCacheSize / 2 - 1 : 0;
+}
+
+void uploadTerrain(Ctx* ctx, const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes) {
     glGenVertexArrays(1, &ctx->vao);
     glGenBuffers(1, &ctx->vbo);
     glGenBuffers(1, &ctx->ebo);
@@ -344,19 +869,1046 @@ void createTerrain(Ctx* ctx) {
     glBindVertexArray(ctx->vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, ctx->vbo);
-    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+    switch(ctx->vertexFormat) {
+        case VERTEX_FORMAT_FLOAT:
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            break;
+        case VERTEX_FORMAT_PACKED:
+        case VERTEX_FORMAT_PATCH:
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+            break;
+        case VERTEX_FORMAT_PACKED_NORMAL:
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedNormalVertex), (void*)0);
+            glVertexAttribPointer(1, 2, GL_BYTE, GL_TRUE, sizeof(PackedNormalVertex), (void*)offsetof(PackedNormalVertex, normal));
+            glEnableVertexAttribArray(1);
+            break;
+    }
     glEnableVertexAttribArray(0);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * ctx->count, indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
 
     glBindVertexArray(0);
+}
+
+// Triangulates 'tree' of 'heights' at 'error' & writes the vertices, touching no GL state so
+// the stroke catch-up thread can do it too
+void buildAdaptiveMesh(const Ctx* ctx, RtinTree* tree, const uint32_t* heights, float error, AdaptiveMesh* out) {
+    RtinMesh* mesh = &out->mesh;
+    rtinExtract(tree, error, mesh);
+
+    out->format = meshVertexFormat(ctx, heights);
+    size_t stride = vertexStride(out->format);
+    out->vertexBytes = mesh->vertexCount * stride;
+    out->vertices = malloc(out->vertexBytes);
+    for(uint32_t i = 0; i < mesh->vertexCount; i++)
+        writeVertex(ctx, out->format, heights, tree->width, tree->height, 1, mesh->vertices[i] & 0xffff, mesh->vertices[i] >> 16, out->vertices + i * stride);
+}
+
+void freeAdaptiveMesh(AdaptiveMesh* mesh) {
+    free(mesh->vertices);
+    rtinFreeMesh(&mesh->mesh);
+    memset(mesh, 0, sizeof(AdaptiveMesh));
+}
+
+// Replaces the terrain with a built adaptive mesh of 'ctx->rtin' & frees it
+void uploadAdaptiveMesh(Ctx* ctx, AdaptiveMesh* adaptive) {
+    const RtinMesh* mesh = &adaptive->mesh;
+    ctx->vertexFormat = adaptive->format;
+
+    // One list with 32 bit indices, the vertices don't follow the chunk grid
+    ctx->meshLayout = MESH_LAYOUT_LIST;
+    ctx->indexType = GL_UNSIGNED_INT;
+    ctx->count = mesh->indexCount;
+    ctx->indexBytes = mesh->indexCount * sizeof(uint32_t);
+    ctx->chunkCount = 1;
+    ctx->chunksX = ctx->chunksY = 1;
+    ctx->lodLevels = 1;
+    ctx->chunks = malloc(sizeof(TerrainChunk));
+    ctx->chunks[0] = (TerrainChunk){
+        .count = mesh->indexCount,
+        .extentX = (ctx->rtin.width - 1) / 2.0f,
+        .extentZ = (ctx->rtin.height - 1) / 2.0f,
+        .centerY = ctx->settings.maxHeight / 2.0f,
+        .extentY = ctx->settings.maxHeight / 2.0f
+    };
+    ctx->drawCommands = malloc(sizeof(DrawCommand));
+
+    uploadTerrain(ctx, adaptive->vertices, adaptive->vertexBytes, mesh->indices, ctx->indexBytes);
+    freeAdaptiveMesh(adaptive);
+}
+
+// Re-triangulates the adaptive mesh at the current error threshold, the error tree is kept
+void remeshTerrain(Ctx* ctx) {
+    AdaptiveMesh mesh;
+    buildAdaptiveMesh(ctx, &ctx->rtin, ctx->rtinHeights, ctx->rtinError, &mesh);
+    uploadAdaptiveMesh(ctx, &mesh);
+}
+
+// One PATCH_SIZE quad patch instanced over the grid, the vertex shader places it & reads the
+// heights from the texture. The vertex & index buffers are the same whatever the grid size,
+// and only a change of 'step' needs new instances.
+void createPatchTerrain(Ctx* ctx, uint32_t width, uint32_t height, uint32_t step) {
+    uint32_t dim = PATCH_SIZE + 1;
+    PackedVertex* vertices = malloc(dim * dim * sizeof(PackedVertex));
+    for(uint32_t y = 0; y < dim; y++) {
+        for(uint32_t x = 0; x < dim; x++)
+            vertices[y * dim + x] = (PackedVertex){ (uint16_t)x, 0, (uint16_t)y };
+    }
+
+    ctx->meshLayout = ctx->settings.meshLayout;
+    ctx->indexType = GL_UNSIGNED_SHORT;
+    ctx->vertexFormat = VERTEX_FORMAT_PATCH;
+    ctx->lodLevels = 1;
+    ctx->patchStep = step;
+    uint32_t count = meshIndexCount(ctx->meshLayout, dim, dim, meshStripe(&ctx->settings));
+    uint32_t* wide = malloc(count * sizeof(uint32_t));
+    uint16_t* indices = malloc(count * sizeof(uint16_t));
+    meshBuildIndices(ctx->meshLayout, dim, dim, meshStripe(&ctx->settings), wide);
+    meshNarrowIndices(wide, count, indices);
+    ctx->indexBytes = count * sizeof(uint16_t);
+    free(wide);
+
+    // Patches past the last row & column are clamped onto it by the shader
+    ctx->chunksX = width > 2 ? (width - 2) / PATCH_SIZE + 1 : 1;
+    ctx->chunksY = height > 2 ? (height - 2) / PATCH_SIZE + 1 : 1;
+    ctx->chunkCount = ctx->chunksX * ctx->chunksY;
+    ctx->chunks = malloc(ctx->chunkCount * sizeof(TerrainChunk));
+    ctx->patches = malloc(ctx->chunkCount * sizeof(PatchInstance));
+    ctx->instances = malloc(ctx->chunkCount * sizeof(PatchInstance));
+    ctx->drawCommands = 0;
+    ctx->count = 0;
+    uint32_t gridWidth = (uint32_t)ctx->settings.gridWidth, gridHeight = (uint32_t)ctx->settings.gridHeight;
+    uint32_t lastX = gridWidth > 1 ? gridWidth - 1 : 0, lastZ = gridHeight > 1 ? gridHeight - 1 : 0;
+    for(uint32_t c = 0; c < ctx->chunkCount; c++) {
+        uint32_t x0 = c % ctx->chunksX * PATCH_SIZE * step;
+        uint32_t z0 = c / ctx->chunksX * PATCH_SIZE * step;
+        uint32_t x1 = x0 + PATCH_SIZE * step < lastX ? x0 + PATCH_SIZE * step : lastX;
+        uint32_t z1 = z0 + PATCH_SIZE * step < lastZ ? z0 + PATCH_SIZE * step : lastZ;
+
+        ctx->patches[c] = (PatchInstance){ (float)x0, (float)z0, (float)step };
+        ctx->chunks[c] = (TerrainChunk){
+            .count = count,
+            .extentX = (x1 - x0) / 2.0f,
+            .extentZ = (z1 - z0) / 2.0f,
+            .centerX = (x0 + x1) / 2.0f - lastX / 2.0f,
+            .centerZ = (z0 + z1) / 2.0f - lastZ / 2.0f,
+            // The patches outlive the heightmap they were made with
+            .centerY = ctx->settings.maxHeight / 2.0f,
+            .extentY = ctx->settings.maxHeight / 2.0f
+        };
+        ctx->count += count;
+    }
+
+    uploadTerrain(ctx, vertices, dim * dim * sizeof(PackedVertex), indices, ctx->indexBytes);
+    free(indices);
+    free(vertices);
+
+    glBindVertexArray(ctx->vao);
+    glGenBuffers(1, &ctx->instanceVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, ctx->chunkCount * sizeof(PatchInstance), 0, GL_STREAM_DRAW);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(PatchInstance), (void*)0);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+}
+
+// Builds the mesh from a width x height heightmap whose samples are 'step' grid units apart.
+// Chunks of the same size share their indices, so the index buffer holds at most 4 index
+// sets (inner, right, bottom & corner chunks) however large the grid is. With LOD every
+// set has all detail levels & their 16 stitch variants.
+void createTerrain(Ctx* ctx, const uint32_t* heights, uint32_t width, uint32_t height, uint32_t step) {
+    // Coarse passes are small already, only the full resolution heights get the adaptive mesh
+    if(ctx->rtinError > 0.0f && heights && step == 1 && !ctx->settings.instanced) {
+        rtinDestroy(&ctx->rtin);
+        if(rtinBuild(&ctx->rtin, heights, width, height, (float)ctx->settings.maxHeight / 255.0f)) {
+            ctx->rtinHeights = heights;
+            remeshTerrain(ctx);
+            return;
+        }
+        ERROR("Couldn't build the error tree (out of memory, or too far from a 2^k + 1 square), using the full grid!\n");
+    }
+    ctx->rtinHeights = 0;
+
+    if(ctx->settings.instanced) {
+        createPatchTerrain(ctx, width, height, step);
+        return;
+    }
+
+    ctx->chunkCount = meshChunkCount(width, height);
+    MeshChunk* chunks = malloc(ctx->chunkCount * sizeof(MeshChunk));
+    meshBuildChunks(width, height, chunks);
+
+    size_t size;
+    void* data = buildVertices(ctx, heights, width, height, step, chunks, ctx->chunkCount, &size);
+
+    ctx->meshLayout = ctx->settings.meshLayout;
+    ctx->indexType = GL_UNSIGNED_SHORT;
+    ctx->lodLevels = ctx->settings.lodDistance > 0.0f ? MESH_LOD_LEVELS : 1;
+    uint32_t variants = ctx->lodLevels > 1 ? MESH_STITCH_VARIANTS : 1;
+    uint32_t stripe = meshStripe(&ctx->settings);
+
+    uint16_t* indices = 0;
+    ctx->shapeCount = 0;
+    ctx->indexBytes = 0;
+    ctx->count = 0;
+    ctx->chunksX = 0;
+    ctx->chunks = malloc(ctx->chunkCount * sizeof(TerrainChunk));
+    ctx->drawCommands = malloc(ctx->chunkCount * sizeof(DrawCommand));
+
+    Pyramid pyramid;
+    pyramidInit(&pyramid, width, height);
+    float unitHeight = (float)ctx->settings.maxHeight / 255.0f;
+
+    int32_t baseVertex = 0;
+    for(uint32_t c = 0; c < ctx->chunkCount; c++) {
+        uint32_t s = 0;
+        while(s < ctx->shapeCount && (ctx->shapes[s].width != chunks[c].width || ctx->shapes[s].height != chunks[c].height))
+            s++;
+
+        if(s == ctx->shapeCount) {
+            TerrainShape* shape = &ctx->shapes[ctx->shapeCount++];
+            shape->width = chunks[c].width;
+            shape->height = chunks[c].height;
+
+            for(uint32_t level = 0; level < ctx->lodLevels; level++) {
+                uint32_t count = meshLodIndexCount(ctx->meshLayout, shape->width, shape->height, stripe, level);
+                uint32_t* wide = malloc(count * sizeof(uint32_t));
+                shape->offsets[level] = ctx->indexBytes;
+                shape->counts[level] = count;
+
+                indices = realloc(indices, ctx->indexBytes + (size_t)count * variants * sizeof(uint16_t));
+                for(uint32_t edges = 0; edges < variants; edges++) {
+                    meshBuildLodIndices(ctx->meshLayout, shape->width, shape->height, stripe, level, edges, wide);
+                    meshNarrowIndices(wide, count, (uint16_t*)((uint8_t*)indices + ctx->indexBytes));
+                    ctx->indexBytes += count * sizeof(uint16_t);
+                }
+                free(wide);
+            }
+        }
+
+        // Centred like the vertices, in world units
+        float x0 = (float)(chunks[c].x * step) - (ctx->settings.gridWidth - 1) / 2.0f;
+        float z0 = (float)(chunks[c].y * step) - (ctx->settings.gridHeight - 1) / 2.0f;
+        TerrainChunk* chunk = &ctx->chunks[c];
+        chunk->baseVertex = baseVertex;
+        chunk->grid = chunks[c];
+        chunk->shape = s;
+        chunk->level = 0;
+        chunk->indexOffset = ctx->shapes[s].offsets[0];
+        chunk->count = ctx->shapes[s].counts[0];
+        chunk->extentX = (chunks[c].width - 1) * step / 2.0f;
+        chunk->extentZ = (chunks[c].height - 1) * step / 2.0f;
+        chunk->centerX = x0 + chunk->extentX;
+        chunk->centerZ = z0 + chunk->extentZ;
+        chunk->centerY = chunk->extentY = ctx->settings.maxHeight / 2.0f;
+        if(heights) {
+            uint8_t min, max;
+            pyramidMinMax(&pyramid, heights, chunks[c].x, chunks[c].y, chunks[c].x + chunks[c].width - 1, chunks[c].y + chunks[c].height - 1, &min, &max);
+            chunk->centerY = (min + max) * unitHeight / 2.0f;
+            chunk->extentY = (max - min) * unitHeight / 2.0f;
+        }
+        ctx->count += chunk->count;
+        baseVertex += chunks[c].width * chunks[c].height;
+        if(chunks[c].y == 0)
+            ctx->chunksX++;
+    }
+    ctx->chunksY = ctx->chunkCount / ctx->chunksX;
+    free(chunks);
+
+    uploadTerrain(ctx, data, size, indices, ctx->indexBytes);
 
     free(indices);
     free(data);
 }
 
+// Picks every chunk's detail level from its distance to the camera, a level per doubling of
+// 'lodDistance'. Chunks are then refined until neighbours are at most one level apart, so
+// an edge is either unstitched or stitched to exactly the next level.
+void selectChunkLods(Ctx* ctx) {
+    Vec3 eye = ctx->camera.pos;
+    float lodDistance = ctx->settings.lodDistance;
+    for(uint32_t c = 0; c < ctx->chunkCount; c++) {
+        TerrainChunk* chunk = &ctx->chunks[c];
+        float dx = fmaxf(fabsf(eye.x - chunk->centerX) - chunk->extentX, 0.0f);
+        float dz = fmaxf(fabsf(eye.z - chunk->centerZ) - chunk->extentZ, 0.0f);
+        float distance = sqrtf(dx * dx + dz * dz);
+        uint32_t level = 0;
+        while(level + 1 < ctx->lodLevels && distance >= lodDistance * (float)(1u << level))
+            level++;
+        chunk->level = level;
+    }
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(uint32_t c = 0; c < ctx->chunkCount; c++) {
+            uint32_t x = c % ctx->chunksX, y = c / ctx->chunksX;
+            uint32_t* level = &ctx->chunks[c].level;
+            uint32_t neighbours[4] = {
+                x > 0 ? c - 1 : c,
+                x + 1 < ctx->chunksX ? c + 1 : c,
+                y > 0 ? c - ctx->chunksX : c,
+                y + 1 < ctx->chunksY ? c + ctx->chunksX : c
+            };
+            for(uint32_t n = 0; n < 4; n++) {
+                if(*level > ctx->chunks[neighbours[n]].level + 1) {
+                    *level = ctx->chunks[neighbours[n]].level + 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    ctx->count = 0;
+    for(uint32_t c = 0; c < ctx->chunkCount; c++) {
+        TerrainChunk* chunk = &ctx->chunks[c];
+        uint32_t x = c % ctx->chunksX, y = c / ctx->chunksX;
+        uint32_t edges = 0;
+        if(x > 0 && ctx->chunks[c - 1].level > chunk->level)
+            edges |= MESH_EDGE_LEFT;
+        if(x + 1 < ctx->chunksX && ctx->chunks[c + 1].level > chunk->level)
+            edges |= MESH_EDGE_RIGHT;
+        if(y > 0 && ctx->chunks[c - ctx->chunksX].level > chunk->level)
+            edges |= MESH_EDGE_BOTTOM;
+        if(y + 1 < ctx->chunksY && ctx->chunks[c + ctx->chunksX].level > chunk->level)
+            edges |= MESH_EDGE_TOP;
+
+        const TerrainShape* shape = &ctx->shapes[chunk->shape];
+        chunk->count = shape->counts[chunk->level];
+        chunk->indexOffset = shape->offsets[chunk->level] + (size_t)edges * chunk->count * sizeof(uint16_t);
+        ctx->count += chunk->count;
+    }
+}
+
+// Clip space planes (ax + by + cz + d >= 0 inside) of a column major view projection matrix
+void frustumPlanes(Mat4 viewProj, float planes[6][4]) {
+    const float* m = viewProj.data;
+    for(uint32_t i = 0; i < 3; i++) {
+        for(uint32_t j = 0; j < 4; j++) {
+            planes[i * 2][j] = m[j * 4 + 3] + m[j * 4 + i];
+            planes[i * 2 + 1][j] = m[j * 4 + 3] - m[j * 4 + i];
+        }
+    }
+}
+
+// Fills the draw commands, or the patch instances of the instanced terrain,
+// of the chunks whose bounds touch the view frustum
+uint32_t cullChunks(Ctx* ctx) {
+    float planes[6][4];
+    frustumPlanes(mat4Mul(ctx->camera.proj, ctx->camera.view), planes);
+
+    size_t indexSize = ctx->indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    uint32_t count = 0;
+    for(uint32_t c = 0; c < ctx->chunkCount; c++) {
+        const TerrainChunk* chunk = &ctx->chunks[c];
+        bool visible = true;
+        for(uint32_t p = 0; p < 6 && visible; p++) {
+            const float* plane = planes[p];
+            float distance = plane[0] * chunk->centerX + plane[1] * chunk->centerY + plane[2] * chunk->centerZ + plane[3];
+            float radius = fabsf(plane[0]) * chunk->extentX + fabsf(plane[1]) * chunk->extentY + fabsf(plane[2]) * chunk->extentZ;
+            visible = distance + radius >= 0.0f;
+        }
+        if(!visible)
+            continue;
+
+        if(ctx->patches) {
+            ctx->instances[count++] = ctx->patches[c];
+            continue;
+        }
+        ctx->drawCommands[count++] = (DrawCommand){
+            .count = chunk->count,
+            .instanceCount = 1,
+            .firstIndex = (uint32_t)(chunk->indexOffset / indexSize),
+            .baseVertex = chunk->baseVertex
+        };
+    }
+    return count;
+}
+
+void putTerrainUniforms(Ctx* ctx, uint32_t program) {
+    glUseProgram(program);
+    putMat4Shader(program, "u_Proj", ctx->camera.proj);
+    putMat4Shader(program, "u_View", ctx->camera.view);
+    glUniform2f(glGetUniformLocation(program, "u_TexRes"), (float)ctx->settings.gridWidth, (float)ctx->settings.gridHeight);
+    glUniform1f(glGetUniformLocation(program, "u_MaxHeight"), (float)ctx->settings.maxHeight);
+    glUniform1f(glGetUniformLocation(program, "u_Ambient"), 0.01f);
+    glUniform3f(glGetUniformLocation(program, "u_LightPos"), LIGHT_POS);
+    glUniform1f(glGetUniformLocation(program, "u_SkyLight"), SKY_LIGHT);
+
+    glUniform1i(glGetUniformLocation(program, "u_ShowViewshed"), ctx->showViewshed);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, ctx->viewshedTex);
+    glUniform1i(glGetUniformLocation(program, "u_Viewshed"), 1);
+    glUniform1i(glGetUniformLocation(program, "u_UseBake"), ctx->useBake);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, ctx->bakeTex);
+    glUniform1i(glGetUniformLocation(program, "u_Bake"), 2);
+    glUniform1i(glGetUniformLocation(program, "u_NormalMap"), ctx->useNormalMap);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, ctx->normalTex);
+    glUniform1i(glGetUniformLocation(program, "u_Normals"), 3);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    glUniform1i(glGetUniformLocation(program, "u_Tex"), 0);
+}
+
+// The patch corners go through default.vert as packed vertices lifted from the texture
+void drawTessTerrain(Ctx* ctx) {
+    uint32_t program = ctx->tess.program;
+    putTerrainUniforms(ctx, program);
+    glUniform1i(glGetUniformLocation(program, "u_HeightFromTex"), true);
+    glUniform1i(glGetUniformLocation(program, "u_VertexFormat"), VERTEX_FORMAT_PACKED);
+    glUniform2f(glGetUniformLocation(program, "u_Viewport"), (float)ctx->width, (float)ctx->height);
+    glUniform1f(glGetUniformLocation(program, "u_TessPixels"), ctx->settings.tessPixels);
+    glUniform1f(glGetUniformLocation(program, "u_TessMaxLevel"), (float)TESS_PATCH_SIZE);
+
+    double start = glfwGetTime();
+    tessDraw(&ctx->tess);
+    ctx->submitTime = glfwGetTime() - start;
+    ctx->drawCount = ctx->tess.patchCount;
+    ctx->drawCalls = 1;
+}
+
+void drawTerrain(Ctx* ctx) {
+    if(ctx->useTess) {
+        drawTessTerrain(ctx);
+        return;
+    }
+
+    putTerrainUniforms(ctx, ctx->shader);
+    glUniform1i(glGetUniformLocation(ctx->shader, "u_HeightFromTex"), ctx->settings.compute);
+    glUniform1i(glGetUniformLocation(ctx->shader, "u_VertexFormat"), ctx->vertexFormat);
+
+    if(ctx->lodLevels > 1)
+        selectChunkLods(ctx);
+
+    glBindVertexArray(ctx->vao);
+    GLenum mode = GL_TRIANGLES;
+    if(ctx->meshLayout == MESH_LAYOUT_STRIP) {
+        mode = GL_TRIANGLE_STRIP;
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(MESH_RESTART_INDEX16);
+    }
+    ctx->drawCount = cullChunks(ctx);
+    double start = glfwGetTime();
+    if(ctx->patches) {
+        glBindBuffer(GL_ARRAY_BUFFER, ctx->instanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, ctx->chunkCount * sizeof(PatchInstance), 0, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, ctx->drawCount * sizeof(PatchInstance), ctx->instances);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if(ctx->drawCount > 0)
+            glDrawElementsInstanced(mode, ctx->chunks[0].count, ctx->indexType, 0, ctx->drawCount);
+        ctx->drawCalls = ctx->drawCount > 0;
+    } else {
+        ctx->drawCalls = indirectSubmit(&ctx->indirect, mode, ctx->indexType, ctx->drawCommands, ctx->drawCount);
+    }
+    ctx->submitTime = glfwGetTime() - start;
+    glDisable(GL_PRIMITIVE_RESTART);
+}
+
+void destroyTerrain(Ctx* ctx) {
+    // The error tree outlives the mesh, remeshTerrain only swaps the buffers
+    free(ctx->chunks);
+    free(ctx->drawCommands);
+    free(ctx->patches);
+    free(ctx->instances);
+    ctx->chunks = 0;
+    ctx->drawCommands = 0;
+    ctx->patches = ctx->instances = 0;
+    ctx->chunkCount = 0;
+    glDeleteBuffers(1, &ctx->instanceVbo);
+    ctx->instanceVbo = 0;
+    glDeleteBuffers(1, &ctx->ebo);
+    glDeleteBuffers(1, &ctx->vbo);
+    glDeleteVertexArrays(1, &ctx->vao);
+    ctx->ebo = ctx->vbo = ctx->vao = 0;
+}
+
+uint32_t passSize(uint32_t gridSize, uint32_t step) {
+    return (gridSize - 1 + step - 1) / step + 1;
+}
+
+// The heightmap is followed by its mip pyramid, built on the same thread. A pass cancelled
+// through 'cancel' (optional) comes back unfinished.
+uint32_t* generatePass(const NoiseProgram* program, const NoiseWarp* warp, int seed, GenPass pass, uint32_t gridWidth, uint32_t gridHeight, const atomic_bool* cancel) {
+    uint32_t width = passSize(gridWidth, pass.step);
+    uint32_t height = passSize(gridHeight, pass.step);
+    Pyramid pyramid;
+    pyramidInit(&pyramid, width, height);
+    uint32_t* data = malloc(pyramid.texelCount * sizeof(uint32_t));
+
+    NoiseProgram limited = *program;
+    limited.octaveLimit = pass.octaves;
+    if(limited.fixedOctaves > pass.octaves)
+        limited.fixedOctaves = pass.octaves;
+
+    getHeight(&limited, warp, seed, pass.step, width, height, data, cancel);
+    if(cancel && atomic_load(cancel))
+        return data;
+    pyramidBuild(&pyramid, data);
+    return data;
+}
+
+// World space positions of the full resolution grid, as the float vertex format lays them out
+float* terrainPositions(const Ctx* ctx, const uint32_t* heights) {
+    uint32_t width = ctx->settings.gridWidth;
+    uint32_t height = ctx->settings.gridHeight;
+    float* positions = malloc((size_t)width * height * 3 * sizeof(float));
+    for(uint32_t y = 0; y < height; y++) {
+        for(uint32_t x = 0; x < width; x++)
+            writeVertex(ctx, VERTEX_FORMAT_FLOAT, heights, width, height, 1, x, y, (uint8_t*)&positions[((size_t)y * width + x) * 3]);
+    }
+    return positions;
+}
+
+// Decimates the full resolution grid & writes it as an OBJ, the border stays
+// at full resolution so neighbouring exports line up
+void exportTerrain(Ctx* ctx, const uint32_t* heights) {
+    uint32_t width = ctx->settings.gridWidth;
+    uint32_t height = ctx->settings.gridHeight;
+    float* positions = terrainPositions(ctx, heights);
+    uint32_t count = meshIndexCount(MESH_LAYOUT_LIST, width, height, 0);
+    uint32_t* indices = malloc(count * sizeof(uint32_t));
+    meshBuildIndices(MESH_LAYOUT_LIST, width, height, 0, indices);
+
+    QemSettings settings = {
+        .targetTriangles = (uint32_t)ctx->settings.exportTriangles,
+        .maxError = ctx->settings.exportError
+    };
+    QemMesh mesh;
+    double start = glfwGetTime();
+    bool ok = qemSimplify(positions, width * height, indices, count, &settings, &mesh);
+    double elapsed = glfwGetTime() - start;
+    free(indices);
+    free(positions);
+    if(!ok) {
+        ERROR("Couldn't simplify the terrain for exporting!\n");
+        return;
+    }
+
+    FILE* file = fopen(ctx->settings.exportPath, "w");
+    if(!file) {
+        ERROR("Couldn't open %s for writing!\n", ctx->settings.exportPath);
+        qemFreeMesh(&mesh);
+        return;
+    }
+    fprintf(file, "# PerlinTerrain, %u vertices, %u triangles\n", mesh.vertexCount, mesh.indexCount / 3);
+    for(uint32_t i = 0; i < mesh.vertexCount; i++)
+        fprintf(file, "v %f %f %f\n", mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2]);
+    for(uint32_t i = 0; i < mesh.indexCount; i += 3)
+        fprintf(file, "f %u %u %u\n", mesh.indices[i] + 1, mesh.indices[i + 1] + 1, mesh.indices[i + 2] + 1);
+    fclose(file);
+
+    INFO("Exported %u of %u triangles to %s, simplified in %.2f ms\n", mesh.indexCount / 3, count / 3, ctx->settings.exportPath, elapsed * 1000.0);
+    qemFreeMesh(&mesh);
+}
+
+// Bakes ambient occlusion & sun shadows for a generated pass on the calling thread, and the
+// normals too once it is the final one
+PassResult bakePass(const Generator* gen, uint32_t* data, GenPass pass, bool final) {
+    PassResult result = { .data = data };
+    uint32_t width = passSize(gen->gridWidth, pass.step);
+    uint32_t height = passSize(gen->gridHeight, pass.step);
+
+    float sun[3] = { LIGHT_POS };
+    if(gen->bake) {
+        if(horizonBakeInit(&result.bake, width, height, (float)pass.step, gen->unitHeight, sun)) {
+            horizonBakeUpdate(&result.bake, data, 0, 0, width - 1, height - 1);
+        } else {
+            ERROR("Couldn't allocate the horizon bake, lighting stays flat!\n");
+            horizonBakeDestroy(&result.bake);
+        }
+    }
+    if(gen->normalMap && final) {
+        if(normalMapInit(&result.normalMap, width, height, (float)pass.step, gen->unitHeight)) {
+            normalMapUpdate(&result.normalMap, data, 0, 0, width - 1, height - 1);
+        } else {
+            ERROR("Couldn't allocate the normal map, normals stay per vertex!\n");
+            normalMapDestroy(&result.normalMap);
+        }
+    }
+    return result;
+}
+
+void passResultFree(PassResult* result) {
+    free(result->data);
+    horizonBakeDestroy(&result->bake);
+    normalMapDestroy(&result->normalMap);
+    memset(result, 0, sizeof(PassResult));
+}
+
+// Uploads a finished pass to the textures and rebuilds the mesh from it, takes over its data
+void applyPass(Ctx* ctx, PassResult* result, GenPass pass, bool final) {
+    uint32_t* data = result->data;
+    uint32_t width = passSize(ctx->settings.gridWidth, pass.step);
+    uint32_t height = passSize(ctx->settings.gridHeight, pass.step);
+
+    // The shader samples with normalized coordinates, so a coarse texture
+    // covers the same terrain as the full resolution one
+    Pyramid pyramid;
+    pyramidInit(&pyramid, width, height);
+    glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    pyramidUpload(&pyramid, data);
+
+    // The pass's bake & normal map are taken over like its heights, and uploaded whole. Coarse
+    // passes have no normal map and are lit per vertex.
+    horizonBakeDestroy(&ctx->bake);
+    ctx->bake = result->bake;
+    ctx->useBake = ctx->bake.texels != 0;
+    if(ctx->useBake) {
+        glBindTexture(GL_TEXTURE_2D, ctx->bakeTex);
+        horizonBakeUpload(&ctx->bake, true);
+        glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    }
+    normalMapDestroy(&ctx->normalMap);
+    ctx->normalMap = result->normalMap;
+    ctx->useNormalMap = ctx->normalMap.texels != 0;
+    if(ctx->useNormalMap) {
+        glBindTexture(GL_TEXTURE_2D, ctx->normalTex);
+        normalMapUpload(&ctx->normalMap, true, 0, 0, width - 1, height - 1);
+        glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    }
+
+    // The instanced terrain only reads the texture, the patches stay unless their scale changes
+    if(!ctx->patches || ctx->patchStep != pass.step) {
+        destroyTerrain(ctx);
+        createTerrain(ctx, data, width, height, pass.step);
+    }
+
+    if(final) {
+        free(ctx->data);
+        ctx->data = data;
+        ctx->showViewshed = false;
+        heightTreeDestroy(&ctx->heightTree);
+        if(!heightTreeBuild(&ctx->heightTree, data, width, height, (float)ctx->settings.maxHeight / 255.0f))
+            ERROR("Couldn't build the height quadtree, picking is off!\n");
+        if(ctx->program.fixedPoint)
+            INFO("Heightmap hash :- %016llx\n", (unsigned long long)hashHeightmap(ctx->data, ctx->settings.gridWidth * ctx->settings.gridHeight));
+        if(ctx->settings.exportPath && !ctx->exported) {
+            exportTerrain(ctx, ctx->data);
+            ctx->exported = true;
+        }
+    } else {
+        free(data);
+    }
+    memset(result, 0, sizeof(PassResult));
+}
+
+// World space ray through a pixel of the window, from the near to the far plane
+Ray cursorRay(const Ctx* ctx, double cursorX, double cursorY) {
+    Mat4 inverse = mat4Inverse(mat4Mul(ctx->camera.proj, ctx->camera.view));
+    float ndc[2] = { (float)(2.0 * cursorX / ctx->width - 1.0), (float)(1.0 - 2.0 * cursorY / ctx->height) };
+    float ends[2][3];
+    for(uint32_t e = 0; e < 2; e++) {
+        float clip[4] = { ndc[0], ndc[1], e == 0 ? -1.0f : 1.0f, 1.0f };
+        float world[4] = { 0 };
+        for(uint32_t i = 0; i < 4; i++) {
+            for(uint32_t j = 0; j < 4; j++)
+                world[i] += inverse.data[j * 4 + i] * clip[j];
+        }
+        for(uint32_t i = 0; i < 3; i++)
+            ends[e][i] = world[i] / world[3];
+    }
+
+    Ray ray = { .maxT = 1.0f };
+    for(uint32_t i = 0; i < 3; i++) {
+        ray.origin[i] = ends[0][i];
+        ray.dir[i] = ends[1][i] - ends[0][i];
+    }
+    return ray;
+}
+
+// Casts the cursor's ray against the heightmap, 'hit' is in grid units like the quadtree
+bool cursorTerrainHit(const Ctx* ctx, RayHit* hit) {
+    // The mesh is centred on the origin
+    Ray ray = cursorRay(ctx, ctx->mouseX, ctx->mouseY);
+    ray.origin[0] += (ctx->settings.gridWidth - 1) / 2.0f;
+    ray.origin[2] += (ctx->settings.gridHeight - 1) / 2.0f;
+    return heightTreeRaycast(&ctx->heightTree, &ray, hit);
+}
+
+// Reports the terrain point under the cursor
+void pickTerrain(Ctx* ctx) {
+    if(!ctx->heightTree.levelCount) {
+        ERROR("Nothing to pick, the heightmap isn't on the CPU!\n");
+        return;
+    }
+
+    RayHit hit;
+    if(!cursorTerrainHit(ctx, &hit)) {
+        INFO("Picked nothing\n");
+        return;
+    }
+
+    float x = hit.pos[0] - (ctx->settings.gridWidth - 1) / 2.0f;
+    float z = hit.pos[2] - (ctx->settings.gridHeight - 1) / 2.0f;
+    Vec3 offset = vec3Sub(vec3Create(x, hit.pos[1], z), ctx->camera.pos);
+    INFO("Picked (%.2f, %.2f, %.2f), grid point (%.0f, %.0f), %.2f units away\n", x, hit.pos[1], z, hit.pos[0], hit.pos[2], vec3Length(offset));
+}
+
+// Shades what an observer on the terrain point under the cursor can see, pointing at the
+// sky hides the overlay again
+void placeObserver(Ctx* ctx) {
+    RayHit hit;
+    if(!ctx->heightTree.levelCount || !cursorTerrainHit(ctx, &hit)) {
+        ctx->showViewshed = false;
+        return;
+    }
+
+    uint32_t width = ctx->settings.gridWidth, height = ctx->settings.gridHeight;
+    uint32_t x = (uint32_t)(hit.pos[0] + 0.5f), z = (uint32_t)(hit.pos[2] + 0.5f);
+    x = x < width ? x : width - 1;
+    z = z < height ? z : height - 1;
+    uint8_t* mask = malloc((size_t)width * height);
+    double start = glfwGetTime();
+    uint64_t seen = viewshedCompute(&ctx->heightTree, x, z, VIEWSHED_OBSERVER_HEIGHT, VIEWSHED_TARGET_HEIGHT, mask);
+    double time = glfwGetTime() - start;
+
+    // Rows of R8 texels aren't 4 byte aligned for odd widths
+    glBindTexture(GL_TEXTURE_2D, ctx->viewshedTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, mask);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    free(mask);
+
+    ctx->showViewshed = true;
+    INFO("Observer at grid point (%u, %u) sees %.2f%% of the terrain, %.2fms\n", x, z, 100.0 * seen / ((double)width * height), time * 1000.0);
+}
+
+// Rewrites the vertices of every chunk row holding grid points of 'rect' from ctx->data, one
+// glBufferSubData per chunk, and refreshes the height bounds of those chunks for culling
+void updateTerrainChunks(Ctx* ctx, const Pyramid* pyramid, DirtyRect rect) {
+    uint32_t width = ctx->settings.gridWidth, height = ctx->settings.gridHeight;
+    float unitHeight = (float)ctx->settings.maxHeight / 255.0f;
+    size_t stride = vertexStride(ctx->vertexFormat);
+    uint8_t* rows = malloc((size_t)MESH_CHUNK_DIM * MESH_CHUNK_DIM * stride);
+    if(!rows) {
+        ERROR("Couldn't allocate the chunk vertices, the mesh misses the sculpted heights!\n");
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->vbo);
+    for(uint32_t c = 0; c < ctx->chunkCount; c++) {
+        TerrainChunk* chunk = &ctx->chunks[c];
+        const MeshChunk* grid = &chunk->grid;
+        uint32_t gx1 = grid->x + grid->width - 1, gz1 = grid->y + grid->height - 1;
+        if(grid->x > rect.x1 || gx1 < rect.x0 || grid->y > rect.z1 || gz1 < rect.z0)
+            continue;
+
+        uint32_t z0 = grid->y > rect.z0 ? grid->y : rect.z0;
+        uint32_t z1 = gz1 < rect.z1 ? gz1 : rect.z1;
+        uint8_t* v = rows;
+        for(uint32_t z = z0; z <= z1; z++) {
+            for(uint32_t x = grid->x; x <= gx1; x++, v += stride)
+                writeVertex(ctx, ctx->vertexFormat, ctx->data, width, height, 1, x, z, v);
+        }
+        size_t first = (size_t)chunk->baseVertex + (size_t)(z0 - grid->y) * grid->width;
+        glBufferSubData(GL_ARRAY_BUFFER, first * stride, (size_t)(v - rows), rows);
+
+        uint8_t min, max;
+        pyramidMinMax(pyramid, ctx->data, grid->x, grid->y, gx1, gz1, &min, &max);
+        chunk->centerY = (min + max) * unitHeight / 2.0f;
+        chunk->extentY = (max - min) * unitHeight / 2.0f;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    free(rows);
+}
+
+// Brings the mip pyramid, quadtree, normal map & mesh up to date with the texels sculpted
+// since the last call, uploading only the rectangles that changed
+void uploadTerrainEdits(Ctx* ctx) {
+    if(dirtyRectEmpty(&ctx->editRect))
+        return;
+
+    uint32_t width = ctx->settings.gridWidth, height = ctx->settings.gridHeight;
+    DirtyRect rect = ctx->editRect;
+    // Normals, baked ones in the vertices included, also depend on the neighbouring heights
+    DirtyRect around = dirtyRectExpand(&rect, 1, width, height);
+    Pyramid pyramid;
+    pyramidInit(&pyramid, width, height);
+    pyramidUpdate(&pyramid, ctx->data, rect.x0, rect.z0, rect.x1, rect.z1);
+    heightTreeUpdate(&ctx->heightTree, ctx->data, rect.x0, rect.z0, rect.x1, rect.z1);
+    if(ctx->useNormalMap)
+        normalMapUpdate(&ctx->normalMap, ctx->data, around.x0, around.z0, around.x1, around.z1);
+
+    double start = glfwGetTime();
+    glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    pyramidUploadRect(&pyramid, ctx->data, rect.x0, rect.z0, rect.x1, rect.z1);
+    if(ctx->useNormalMap) {
+        glBindTexture(GL_TEXTURE_2D, ctx->normalTex);
+        normalMapUpload(&ctx->normalMap, false, around.x0, around.z0, around.x1, around.z1);
+        glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    }
+    // The instanced patches read the texture & the adaptive mesh is rebuilt when the stroke ends
+    if(!ctx->patches && !ctx->rtinHeights)
+        updateTerrainChunks(ctx, &pyramid, ctx->vertexFormat == VERTEX_FORMAT_PACKED_NORMAL ? around : rect);
+    ctx->strokeUpload += glfwGetTime() - start;
+
+    dirtyRectAdd(&ctx->strokeRect, &ctx->editRect);
+    dirtyRectReset(&ctx->editRect);
+}
+
+void* catchUpMain(void* arg) {
+    Ctx* ctx = arg;
+    StrokeCatchUp* up = &ctx->catchUp;
+    DirtyRect rect = up->rect;
+    double start = glfwGetTime();
+    if(up->bake)
+        horizonBakeUpdate(&ctx->bake, ctx->data, rect.x0, rect.z0, rect.x1, rect.z1);
+    if(up->rebuildRtin) {
+        up->rtinBuilt = rtinBuild(&up->rtin, ctx->data, ctx->settings.gridWidth, ctx->settings.gridHeight, (float)ctx->settings.maxHeight / 255.0f);
+        if(up->rtinBuilt)
+            buildAdaptiveMesh(ctx, &up->rtin, ctx->data, up->rtinError, &up->mesh);
+    }
+    up->time = glfwGetTime() - start;
+    atomic_store(&up->done, true);
+    return 0;
+}
+
+// Waits for the catch-up thread and drops what it rebuilt, the heights it read are about to go
+void stopCatchUp(Ctx* ctx) {
+    StrokeCatchUp* up = &ctx->catchUp;
+    if(!up->running)
+        return;
+
+    pthread_join(up->thread, 0);
+    rtinDestroy(&up->rtin);
+    freeAdaptiveMesh(&up->mesh);
+    up->running = false;
+}
+
+// Uploads the re-baked texels & swaps in the rebuilt error tree and its mesh
+void applyCatchUp(Ctx* ctx) {
+    StrokeCatchUp* up = &ctx->catchUp;
+    double start = glfwGetTime();
+    if(up->bake && ctx->useBake) {
+        glBindTexture(GL_TEXTURE_2D, ctx->bakeTex);
+        horizonBakeUpload(&ctx->bake, false);
+        glBindTexture(GL_TEXTURE_2D, ctx->tex);
+    }
+    // Switching to the patches meanwhile leaves nothing to remesh
+    if(up->rtinBuilt && ctx->rtinHeights == ctx->data) {
+        rtinDestroy(&ctx->rtin);
+        ctx->rtin = up->rtin;
+        memset(&up->rtin, 0, sizeof(RtinTree));
+        destroyTerrain(ctx);
+        // '[' & ']' meanwhile changed the threshold the mesh was built at
+        if(up->rtinError == ctx->rtinError)
+            uploadAdaptiveMesh(ctx, &up->mesh);
+        else
+            remeshTerrain(ctx);
+    } else if(up->rebuildRtin && !up->rtinBuilt) {
+        ERROR("Couldn't rebuild the error tree, the adaptive mesh misses the stroke!\n");
+    }
+    rtinDestroy(&up->rtin);
+    freeAdaptiveMesh(&up->mesh);
+
+    double time = glfwGetTime() - start;
+    INFO("Caught up with the stroke in %.2fms, %.2fms of it on the render thread\n", (up->time + time) * 1000.0, time * 1000.0);
+}
+
+// Swaps in what the catch-up thread rebuilt once it is done
+void pollCatchUp(Ctx* ctx) {
+    StrokeCatchUp* up = &ctx->catchUp;
+    if(!up->running || !atomic_load(&up->done))
+        return;
+
+    pthread_join(up->thread, 0);
+    up->running = false;
+    applyCatchUp(ctx);
+}
+
+// Re-bakes the horizons of every line through the stroke and rebuilds the adaptive mesh on the
+// catch-up thread, falling back to this one when it can't start. A stroke cut short by a new
+// heightmap is dropped, there is nothing left to update.
+void finishStroke(Ctx* ctx) {
+    if(ctx->data && !ctx->gen.running)
+        uploadTerrainEdits(ctx);
+    DirtyRect rect = ctx->strokeRect;
+    bool dropped = !ctx->data || ctx->gen.running || dirtyRectEmpty(&rect);
+    if(!dropped)
+        INFO("Sculpted %ux%u grid points in %u dabs, %.3fms of uploads per dab\n",
+             rect.x1 - rect.x0 + 1, rect.z1 - rect.z0 + 1, ctx->strokeDabs, ctx->strokeUpload * 1000.0 / (ctx->strokeDabs ? ctx->strokeDabs : 1));
+    dirtyRectReset(&ctx->editRect);
+    dirtyRectReset(&ctx->strokeRect);
+    ctx->strokeDabs = 0;
+    ctx->strokeUpload = 0.0;
+    if(dropped || (!ctx->useBake && !ctx->rtinHeights))
+        return;
+
+    StrokeCatchUp* up = &ctx->catchUp;
+    up->rect = rect;
+    up->bake = ctx->useBake;
+    up->rebuildRtin = ctx->rtinHeights != 0;
+    up->rtinBuilt = false;
+    up->rtinError = ctx->rtinError;
+    memset(&up->rtin, 0, sizeof(RtinTree));
+    memset(&up->mesh, 0, sizeof(AdaptiveMesh));
+    atomic_store(&up->done, false);
+    if(pthread_create(&up->thread, 0, catchUpMain, ctx) != 0) {
+        ERROR("Couldn't start the stroke catch-up thread, catching up on this one!\n");
+        catchUpMain(ctx);
+        applyCatchUp(ctx);
+        return;
+    }
+    up->running = true;
+}
+
+// Dabs the brush on the terrain point under the cursor every frame 'E' is held, releasing it
+// ends the stroke. Needs the final heightmap on the CPU.
+void sculptTerrain(Ctx* ctx) {
+    bool held = glfwGetKey(ctx->window, GLFW_KEY_E) == GLFW_PRESS;
+    if(!held || !ctx->data || ctx->gen.running || ctx->catchUp.running || !ctx->heightTree.levelCount) {
+        if(ctx->strokeDabs > 0 || !dirtyRectEmpty(&ctx->editRect))
+            finishStroke(ctx);
+        return;
+    }
+
+    RayHit hit;
+    if(!cursorTerrainHit(ctx, &hit))
+        return;
+    // A long frame shouldn't dig a pit in one dab
+    float seconds = (float)(ctx->deltaTime < CAMERA_MAX_FRAME_TIME ? ctx->deltaTime : CAMERA_MAX_FRAME_TIME);
+    sculptDab(ctx->data, ctx->settings.gridWidth, ctx->settings.gridHeight, &ctx->brush, hit.pos[0], hit.pos[2], seconds, ctx->strokeDabs, &ctx->editRect);
+    ctx->strokeDabs++;
+    ctx->showViewshed = false;
+    uploadTerrainEdits(ctx);
+}
+
+void* generatorMain(void* arg) {
+    Generator* gen = arg;
+
+    for(uint32_t i = 1; i < gen->passCount && !atomic_load(&gen->cancel); i++) {
+        uint32_t* data = generatePass(&gen->program, &gen->warp, gen->seed, gen->passes[i], gen->gridWidth, gen->gridHeight, &gen->cancel);
+        if(atomic_load(&gen->cancel)) {
+            free(data);
+            break;
+        }
+        PassResult result = bakePass(gen, data, gen->passes[i], i == gen->passCount - 1);
+
+        pthread_mutex_lock(&gen->lock);
+        // A pass the render thread never picked up is already outdated
+        passResultFree(&gen->result);
+        gen->result = result;
+        gen->resultPass = i;
+        pthread_mutex_unlock(&gen->lock);
+    }
+
+    return 0;
+}
+
+void stopGeneration(Ctx* ctx) {
+    Generator* gen = &ctx->gen;
+    if(!gen->running)
+        return;
+
+    atomic_store(&gen->cancel, true);
+    pthread_join(gen->thread, 0);
+    pthread_mutex_destroy(&gen->lock);
+    passResultFree(&gen->result);
+    gen->running = false;
+}
+
+// Generates a coarse, low octave terrain right away and refines it in the
+// background, each refinement is 4x finer until the full grid is reached
+void startGeneration(Ctx* ctx) {
+    Generator* gen = &ctx->gen;
+    stopGeneration(ctx);
+    stopCatchUp(ctx);
+
+    // Everything read from the CPU heights waits for the new full resolution ones
+    free(ctx->data);
+    ctx->data = 0;
+    ctx->showViewshed = false;
+    ctx->useBake = false;
+    ctx->useNormalMap = false;
+    heightTreeDestroy(&ctx->heightTree);
+
+    if(ctx->settings.compute) {
+        gpuGenRun(&ctx->gpuGen, ctx->tex, ctx->settings.gridWidth, ctx->settings.gridHeight, ctx->settings.octaves, nextSeed(&ctx->settings), NOISE_SCALE);
+        if(!ctx->patches || ctx->patchStep != 1) {
+            destroyTerrain(ctx);
+            createTerrain(ctx, 0, ctx->settings.gridWidth, ctx->settings.gridHeight, 1);
+        }
+        return;
+    }
+
+    gen->program = ctx->program;
+    gen->warp = ctx->warp;
+    gen->seed = nextSeed(&ctx->settings);
+    gen->gridWidth = ctx->settings.gridWidth;
+    gen->gridHeight = ctx->settings.gridHeight;
+    gen->passCount = 0;
+    gen->bake = ctx->settings.bake;
+    gen->normalMap = ctx->settings.normalMap;
+    gen->unitHeight = (float)ctx->settings.maxHeight / 255.0f;
+
+    uint32_t step = 1;
+    uint32_t largest = gen->gridWidth > gen->gridHeight ? gen->gridWidth : gen->gridHeight;
+    if(ctx->settings.progressive) {
+        while(largest / step > PROGRESSIVE_FIRST_SIZE)
+            step *= 2;
+    }
+    while(true) {
+        gen->passes[gen->passCount++].step = step;
+        if(step == 1 || gen->passCount == PROGRESSIVE_MAX_PASSES)
+            break;
+        step = step >= 4 ? step / 4 : 1;
+    }
+    gen->passes[gen->passCount - 1].step = 1;
+    for(uint32_t i = 0; i < gen->passCount; i++) {
+        int octaves = ctx->settings.octaves * (int)(i + 1) / (int)gen->passCount;
+        if(i == 0 && gen->passCount > 1)
+            octaves = PROGRESSIVE_FIRST_OCTAVES < ctx->settings.octaves ? PROGRESSIVE_FIRST_OCTAVES : ctx->settings.octaves;
+        gen->passes[i].octaves = octaves > 0 ? octaves : 1;
+    }
+    gen->passes[gen->passCount - 1].octaves = ctx->settings.octaves;
+
+    uint32_t* first = generatePass(&gen->program, &gen->warp, gen->seed, gen->passes[0], gen->gridWidth, gen->gridHeight, 0);
+    PassResult result = bakePass(gen, first, gen->passes[0], gen->passCount == 1);
+    applyPass(ctx, &result, gen->passes[0], gen->passCount == 1);
+
+    if(gen->passCount > 1) {
+        atomic_store(&gen->cancel, false);
+        memset(&gen->result, 0, sizeof(PassResult));
+        pthread_mutex_init(&gen->lock, 0);
+        if(pthread_create(&gen->thread, 0, generatorMain, gen) != 0) {
+            ERROR("Couldn't start the terrain generation thread!\n");
+            pthread_mutex_destroy(&gen->lock);
+            uint32_t* data = generatePass(&gen->program, &gen->warp, gen->seed, gen->passes[gen->passCount - 1], gen->gridWidth, gen->gridHeight, 0);
+            result = bakePass(gen, data, gen->passes[gen->passCount - 1], true);
+            applyPass(ctx, &result, gen->passes[gen->passCount - 1], true);
+            return;
+        }
+        gen->running = true;
+    }
+}
+
+// Picks up the newest pass finished by the generator thread
+void pollGeneration(Ctx* ctx) {
+    Generator* gen = &ctx->gen;
+    if(!gen->running)
+        return;
+
+    pthread_mutex_lock(&gen->lock);
+    PassResult result = gen->result;
+    uint32_t pass = gen->resultPass;
+    memset(&gen->result, 0, sizeof(PassResult));
+    pthread_mutex_unlock(&gen->lock);
+
+    if(!result.data)
+        return;
+
+    bool final = pass == gen->passCount - 1;
+    applyPass(ctx, &result, gen->passes[pass], final);
+    if(final)
+        stopGeneration(ctx);
+}
+
 int parseArg(const char* arg) {
     int val = -1.0;
     int len = strlen(arg);
@@ -387,6 +1939,46 @@ int parseArg(const char* arg) {
     return val;
 }
 
+const char* parseStrArg(const char* arg) {
+    const char* value = strchr(arg, '=');
+    if(!value || value[1] == '\0') {
+        ERROR("Parse Issue :- No value provided!\n");
+        exit(1);
+    }
+    return value + 1;
+}
+
+float parseFloatArg(const char* arg) {
+    const char* str = parseStrArg(arg);
+    char* end = 0;
+    float val = strtof(str, &end);
+    if(end == str) {
+        ERROR("Parse Issue :- No value provided!\n");
+        exit(1);
+    }
+    return val;
+}
+
+VertexFormat parseVertexFormat(const char* str) {
+    if(strcmp(str, "float") == 0)
+        return VERTEX_FORMAT_FLOAT;
+    if(strcmp(str, "packed") == 0)
+        return VERTEX_FORMAT_PACKED;
+    if(strcmp(str, "normals") == 0)
+        return VERTEX_FORMAT_PACKED_NORMAL;
+    ERROR("Unknown vertex format :- %s\n", str);
+    exit(1);
+}
+
+MeshLayout parseMeshLayout(const char* str) {
+    if(strcmp(str, "list") == 0)
+        return MESH_LAYOUT_LIST;
+    if(strcmp(str, "strip") == 0)
+        return MESH_LAYOUT_STRIP;
+    ERROR("Unknown mesh layout :- %s\n", str);
+    exit(1);
+}
+
 bool startsWith(const char* str, const char* start) {
     return strncmp(str, start, strlen(start)) == 0;
 }
@@ -397,6 +1989,35 @@ void parseArgs(Settings* settings, int argc, const char** argv) {
     settings->maxHeight = MAX_HEIGHT;
     settings->terrainGenCooldown = TERRAIN_GENERATE_COOLDOWN;
     settings->octaves = OCTAVES;
+    settings->threads = 0;
+    settings->noise = 0;
+    settings->noiseFile = 0;
+    settings->warpStrength = WARP_STRENGTH;
+    settings->warpOctaves = WARP_OCTAVES;
+    settings->noiseBackend = NOISE_BACKEND;
+    settings->cellWeight = CELL_WEIGHT;
+    settings->fixedPoint = false;
+    settings->seed = -1;
+    settings->progressive = true;
+    settings->compute = false;
+    settings->vertexFormat = parseVertexFormat(VERTEX_FORMAT);
+    settings->meshLayout = parseMeshLayout(MESH_LAYOUT);
+    settings->vertexCacheSize = VERTEX_CACHE_SIZE;
+    settings->rtinError = 0.0f;
+    settings->lodDistance = 0.0f;
+    settings->indirect = true;
+    settings->instanced = false;
+    settings->tessellation = false;
+    settings->tessPixels = TESS_PIXELS;
+    settings->walk = false;
+    settings->bake = true;
+    settings->normalMap = true;
+    settings->brushRadius = BRUSH_RADIUS;
+    settings->brushStrength = BRUSH_STRENGTH;
+    settings->exportPath = 0;
+    settings->exportTriangles = 0;
+    settings->exportError = -1.0f;
+    settings->benchmark = false;
 
     if(argc == 1)
         return;
@@ -406,11 +2027,42 @@ void parseArgs(Settings* settings, int argc, const char** argv) {
                  "\toctaves: Number of octaves\n"
                  "\tmaxHeight: Max. height of the terrain\n"
                  "\t'width' & 'height': Dimensions of the terrain\n"
-                 "\tterrainCooldown: Time for cooldown in seconds\n\0");
+                 "\tterrainCooldown: Time for cooldown in seconds\n"
+                 "\tthreads: Worker threads for generation (0 uses every core)\n"
+                 "\tnoise: Noise graph, e.g. noise=\"add(fbm(8), mul(ridge(4), 0.3))\"\n"
+                 "\tnoiseFile: File containing a noise graph\n"
+                 "\twarpStrength: How far the domain warp moves samples (0 disables it)\n"
+                 "\twarpOctaves: Number of octaves of the warp fields\n"
+                 "\tnoiseBackend: 'perlin' or 'simplex'\n"
+                 "\tcells: Weight of the Worley cells mixed into the default terrain\n"
+                 "\tfixedPoint: 1 uses the integer fbm, the same seed gives the same terrain on every machine\n"
+                 "\tseed: Fixed seed instead of the current time\n"
+                 "\tprogressive: 0 generates the full terrain before showing the window\n"
+                 "\tcompute: 1 generates the default fbm with a GL 4.3 compute shader\n"
+                 "\tvertexFormat: 'float' (12 bytes), 'packed' (6 bytes) or 'normals' (8 bytes, packed with baked normals), grids over 65536 use 'float'\n"
+                 "\tmeshLayout: 'list' (6 indices per quad) or 'strip' (one triangle strip per row)\n"
+                 "\tvertexCache: Post-transform cache size the index order is tuned for (0 keeps plain rows)\n"
+                 "\trtinError: Height error in world units of the adaptive mesh (0 uses the full grid), best with 2^k + 1 grids\n"
+                 "\tlodDistance: Distance in world units past which chunks drop a detail level, doubling per level (0 disables LOD)\n"
+                 "\tinstanced: 1 draws one shared 65x65 vertex patch instanced over the grid, heights come from the texture\n"
+                 "\ttessellation: 1 subdivides coarse patches on the GPU instead of drawing the mesh (GL 4.0, 'T' toggles it)\n"
+                 "\ttessPixels: Edge length in pixels the tessellation aims for\n"
+                 "\tnormalMap: 0 computes normals per vertex from 4 texture fetches instead of per fragment from a baked normal map\n"
+                 "\tbake: 0 skips baking ambient occlusion & sun shadows, which takes 10 bytes per grid point\n"
+                 "\tbrushRadius: Radius in grid units of the sculpting brush\n"
+                 "\tbrushStrength: Heightmap units per second the sculpting brush moves the terrain at its centre\n"
+                 "\twalk: 1 starts in walk mode, keeping the camera above the terrain ('F' toggles it)\n"
+                 "\tindirect: 0 draws the visible chunks one by one instead of with one multi draw indirect call\n"
+                 "\texport: OBJ file the first simplified full resolution terrain is written to\n"
+                 "\texportTriangles: Triangle count of the exported mesh (0 only limits the error)\n"
+                 "\texportError: Bound in world units on the root of a collapse's summed squared plane distances (0 only limits the triangles)\n"
+                 "\t--bench: Run the benchmarks and exit\n\0");
             return;
         }
 
-        if(startsWith(argv[i], "octaves")) {
+        if(strcmp(argv[i], "--bench") == 0) {
+            settings->benchmark = true;
+        } else if(startsWith(argv[i], "octaves")) {
             settings->octaves = parseArg(argv[i]);
         } else if(startsWith(argv[i], "terrainCooldown")) {
             settings->terrainGenCooldown = parseArg(argv[i]);
@@ -420,10 +2072,844 @@ void parseArgs(Settings* settings, int argc, const char** argv) {
             settings->gridHeight = parseArg(argv[i]);
         } else if(startsWith(argv[i], "maxHeight")) {
             settings->maxHeight = parseArg(argv[i]);
+        } else if(startsWith(argv[i], "threads")) {
+            settings->threads = parseArg(argv[i]);
+        } else if(startsWith(argv[i], "warpStrength")) {
+            settings->warpStrength = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "warpOctaves")) {
+            settings->warpOctaves = parseArg(argv[i]);
+        } else if(startsWith(argv[i], "fixedPoint")) {
+            settings->fixedPoint = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "exportTriangles")) {
+            settings->exportTriangles = parseArg(argv[i]);
+        } else if(startsWith(argv[i], "exportError")) {
+            settings->exportError = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "export")) {
+            settings->exportPath = parseStrArg(argv[i]);
+        } else if(startsWith(argv[i], "tessellation")) {
+            settings->tessellation = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "tessPixels")) {
+            settings->tessPixels = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "walk")) {
+            settings->walk = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "normalMap")) {
+            settings->normalMap = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "brushRadius")) {
+            settings->brushRadius = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "brushStrength")) {
+            settings->brushStrength = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "bake")) {
+            settings->bake = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "instanced")) {
+            settings->instanced = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "indirect")) {
+            settings->indirect = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "lodDistance")) {
+            settings->lodDistance = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "rtinError")) {
+            settings->rtinError = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "vertexCache")) {
+            settings->vertexCacheSize = parseArg(argv[i]);
+        } else if(startsWith(argv[i], "meshLayout")) {
+            settings->meshLayout = parseMeshLayout(parseStrArg(argv[i]));
+        } else if(startsWith(argv[i], "vertexFormat")) {
+            settings->vertexFormat = parseVertexFormat(parseStrArg(argv[i]));
+        } else if(startsWith(argv[i], "compute")) {
+            settings->compute = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "progressive")) {
+            settings->progressive = parseArg(argv[i]) != 0;
+        } else if(startsWith(argv[i], "seed")) {
+            settings->seed = parseArg(argv[i]);
+        } else if(startsWith(argv[i], "cells")) {
+            settings->cellWeight = parseFloatArg(argv[i]);
+        } else if(startsWith(argv[i], "noiseBackend")) {
+            settings->noiseBackend = parseStrArg(argv[i]);
+        } else if(startsWith(argv[i], "noiseFile")) {
+            settings->noiseFile = parseStrArg(argv[i]);
+        } else if(startsWith(argv[i], "noise")) {
+            settings->noise = parseStrArg(argv[i]);
         } else {
             ERROR("Invalid command line argument! Use '--help' for more information!\n");
         }
     }
+
+    // Without a triangle count the export falls back to the default error
+    if(settings->exportError < 0.0f)
+        settings->exportError = settings->exportTriangles > 0 ? 0.0f : EXPORT_ERROR;
+}
+
+void benchNoiseBackends(Ctx* ctx) {
+    uint32_t width = ctx->settings.gridWidth;
+    uint32_t height = ctx->settings.gridHeight;
+    uint32_t* data = malloc(width * height * sizeof(uint32_t));
+    char graph[32];
+    snprintf(graph, sizeof(graph), "fbm(%d)", ctx->settings.octaves);
+
+    INFO("Noise backends, %ux%u heightmap, %d octaves, %u threads\n", width, height, ctx->settings.octaves, jobsThreadCount());
+    for(uint32_t b = 0; b < noiseBackendCount; b++) {
+        NoiseProgram program;
+        NoiseWarp warp = { 0 };
+        noiseCompile(graph, ctx->settings.octaves, &noiseBackends[b], &program);
+
+        // Raw single thread throughput of the backend itself
+        float xs[NOISE_TILE_SIZE], ys[NOISE_TILE_SIZE], out[NOISE_TILE_SIZE];
+        for(uint32_t i = 0; i < NOISE_TILE_SIZE; i++) {
+            xs[i] = (i % NOISE_TILE_DIM) * 0.137f;
+            ys[i] = (i / NOISE_TILE_DIM) * 0.137f;
+        }
+        uint32_t rounds = 4096;
+        double start = glfwGetTime();
+        for(uint32_t r = 0; r < rounds; r++) {
+            xs[r % NOISE_TILE_SIZE] += 0.001f;
+            noiseBackends[b].noise2(xs, ys, NOISE_TILE_SIZE, 1, out);
+        }
+        double raw = glfwGetTime() - start;
+
+        getHeight(&program, &warp, 1, 1, width, height, data, 0);
+        start = glfwGetTime();
+        uint32_t runs = 3;
+        for(uint32_t r = 0; r < runs; r++)
+            getHeight(&program, &warp, 1, 1, width, height, data, 0);
+        double full = (glfwGetTime() - start) / runs;
+
+        INFO("  %-8s %8.2f M samples/s (1 thread) | getHeight %8.2f ms, %8.2f M samples/s\n",
+             noiseBackends[b].name,
+             rounds * NOISE_TILE_SIZE / raw / 1e6,
+             full * 1000.0,
+             (double)width * height * ctx->settings.octaves / full / 1e6);
+    }
+
+    // Worley cells mixed into the default graph
+    {
+        Settings settings = ctx->settings;
+        NoiseProgram program;
+        NoiseWarp warp = { 0 };
+        char graph[128];
+        double times[2];
+        for(uint32_t i = 0; i < 2; i++) {
+            settings.cellWeight = i == 0 ? 0.0f : 0.3f;
+            defaultNoiseGraph(&settings, graph, sizeof(graph));
+            noiseCompile(graph, settings.octaves, ctx->program.backend, &program);
+            getHeight(&program, &warp, 1, 1, width, height, data, 0);
+            double start = glfwGetTime();
+            getHeight(&program, &warp, 1, 1, width, height, data, 0);
+            times[i] = glfwGetTime() - start;
+        }
+        INFO("  cells    default graph %8.2f ms, with cells mixed in %8.2f ms (x%.2f)\n", times[0] * 1000.0, times[1] * 1000.0, times[1] / times[0]);
+    }
+
+    // Integer fbm against the float default graph
+    {
+        NoiseProgram program;
+        NoiseWarp warp = { 0 };
+        noiseCompile(graph, ctx->settings.octaves, ctx->program.backend, &program);
+        program.fixedPoint = true;
+        program.fixedOctaves = ctx->settings.octaves < 32 ? ctx->settings.octaves : 31;
+        getHeight(&program, &warp, 1, 1, width, height, data, 0);
+        double start = glfwGetTime();
+        getHeight(&program, &warp, 1, 1, width, height, data, 0);
+        double fixed = glfwGetTime() - start;
+        INFO("  fixed    getHeight %8.2f ms, %8.2f M samples/s, hash %016llx\n",
+             fixed * 1000.0,
+             (double)width * height * ctx->settings.octaves / fixed / 1e6,
+             (unsigned long long)hashHeightmap(data, width * height));
+    }
+
+    free(data);
+}
+
+// CPU generation & upload against the compute shader writing the texture
+void benchGpuGen(Ctx* ctx) {
+    if(!ctx->gpuGen.available) {
+        INFO("Compute shader generation unavailable, run with compute=1 on a GL 4.3 driver\n");
+        return;
+    }
+
+    uint32_t width = ctx->settings.gridWidth;
+    uint32_t height = ctx->settings.gridHeight;
+    Pyramid pyramid;
+    pyramidInit(&pyramid, width, height);
+    uint32_t* cpu = malloc(pyramid.texelCount * sizeof(uint32_t));
+    uint32_t* gpu = malloc(width * height * sizeof(uint32_t));
+    char graph[32];
+    snprintf(graph, sizeof(graph), "fbm(%d)", ctx->settings.octaves);
+    NoiseProgram program;
+    NoiseWarp warp = { 0 };
+    noiseCompile(graph, ctx->settings.octaves, noiseFindBackend("perlin"), &program);
+
+    uint32_t tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    uint32_t runs = 3;
+    double times[2] = { 0 };
+    for(uint32_t r = 0; r <= runs; r++) {
+        double start = glfwGetTime();
+        getHeight(&program, &warp, 1, 1, width, height, cpu, 0);
+        pyramidBuild(&pyramid, cpu);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        pyramidUpload(&pyramid, cpu);
+        glFinish();
+        // The first run only warms up caches, threads & the driver
+        if(r > 0)
+            times[0] += glfwGetTime() - start;
+
+        start = glfwGetTime();
+        gpuGenRun(&ctx->gpuGen, tex, width, height, ctx->settings.octaves, 1, NOISE_SCALE);
+        glFinish();
+        if(r > 0)
+            times[1] += glfwGetTime() - start;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, gpu);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &tex);
+
+    uint32_t maxDiff = 0, differing = 0;
+    for(uint32_t i = 0; i < width * height; i++) {
+        int diff = (int)(cpu[i] & 0xff) - (int)(gpu[i] & 0xff);
+        diff = diff < 0 ? -diff : diff;
+        if(diff > 0)
+            differing++;
+        if((uint32_t)diff > maxDiff)
+            maxDiff = diff;
+    }
+
+    INFO("Heightmap generation, %ux%u, %d octaves\n", width, height, ctx->settings.octaves);
+    INFO("  cpu      getHeight + upload %8.2f ms (%u threads)\n", times[0] / runs * 1000.0, jobsThreadCount());
+    INFO("  compute  dispatch           %8.2f ms (x%.2f)\n", times[1] / runs * 1000.0, times[0] / times[1]);
+    INFO("  compute  max. difference %u/255, %u of %u texels differ\n", maxDiff, differing, width * height);
+
+    free(gpu);
+    free(cpu);
+}
+
+// Mip chain built on the CPU & uploaded level by level against the driver's glGenerateMipmap
+void benchPyramid(Ctx* ctx) {
+    uint32_t sizes[2] = { 1025, 2049 };
+    INFO("Heightmap mip pyramid\n");
+    for(uint32_t i = 0; i < 2; i++) {
+        uint32_t size = sizes[i];
+        Pyramid pyramid;
+        pyramidInit(&pyramid, size, size);
+        GenPass pass = { 1, ctx->settings.octaves };
+        uint32_t* data = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, size, size, 0);
+
+        uint32_t tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        uint32_t runs = 5;
+        double times[3] = { 0 };
+        for(uint32_t r = 0; r <= runs; r++) {
+            double start = glfwGetTime();
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glFinish();
+            double driver = glfwGetTime() - start;
+
+            start = glfwGetTime();
+            pyramidBuild(&pyramid, data);
+            double build = glfwGetTime() - start;
+
+            start = glfwGetTime();
+            pyramidUpload(&pyramid, data);
+            glFinish();
+            // The first run only warms up caches, threads & the driver
+            if(r > 0) {
+                times[0] += driver;
+                times[1] += build;
+                times[2] += glfwGetTime() - start;
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDeleteTextures(1, &tex);
+
+        INFO("  %ux%u, %u levels\n", size, size, pyramid.levelCount);
+        INFO("    glTexImage2D + glGenerateMipmap %8.2f ms\n", times[0] / runs * 1000.0);
+        INFO("    pyramid build (min/max)         %8.2f ms (%u threads)\n", times[1] / runs * 1000.0, jobsThreadCount());
+        INFO("    pyramid upload, every level     %8.2f ms\n", times[2] / runs * 1000.0);
+        free(data);
+    }
+}
+
+// Draws 'frames' frames of the current mesh into an offscreen framebuffer, returns ms per frame
+double timeFrames(Ctx* ctx, uint32_t frames) {
+    uint32_t fbo, rbo[2];
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, ctx->width, ctx->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, ctx->width, ctx->height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo[1]);
+
+    glViewport(0, 0, ctx->width, ctx->height);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    // One warm up frame so shader compilation & uploads aren't timed
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawTerrain(ctx);
+    glFinish();
+
+    double start = glfwGetTime();
+    for(uint32_t i = 0; i < frames; i++) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawTerrain(ctx);
+    }
+    glFinish();
+    double time = (glfwGetTime() - start) * 1000.0 / frames;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(2, rbo);
+    glDeleteFramebuffers(1, &fbo);
+    return time;
+}
+
+// Rebuilds the mesh with every index layout & draws it, run with LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe
+void benchMeshLayouts(Ctx* ctx) {
+    if(!ctx->data)
+        return;
+
+    const char* names[] = { "list", "strip" };
+    MeshLayout setting = ctx->settings.meshLayout;
+    uint32_t frames = 20;
+
+    INFO("Mesh layouts, %ux%u grid, %u frames on %s\n", ctx->settings.gridWidth, ctx->settings.gridHeight, frames, glGetString(GL_RENDERER));
+    for(uint32_t i = 0; i < ARR_LEN(names); i++) {
+        ctx->settings.meshLayout = (MeshLayout)i;
+        destroyTerrain(ctx);
+        createTerrain(ctx, ctx->data, ctx->settings.gridWidth, ctx->settings.gridHeight, 1);
+
+        double ms = timeFrames(ctx, frames);
+        INFO("  %-6s %10u indices, %8.2f MB index buffer, %8.2f ms/frame\n", names[i], ctx->count, ctx->indexBytes / (1024.0 * 1024.0), ms);
+    }
+
+    ctx->settings.meshLayout = setting;
+    destroyTerrain(ctx);
+    createTerrain(ctx, ctx->data, ctx->settings.gridWidth, ctx->settings.gridHeight, 1);
+}
+
+// Simulated vertex shader runs per triangle of plain rows against the cache tuned stripes
+void benchVertexCache(Ctx* ctx) {
+    const char* names[] = { "list", "strip" };
+    uint32_t width = ctx->settings.gridWidth;
+    uint32_t height = ctx->settings.gridHeight;
+    uint32_t stripe = meshStripe(&ctx->settings);
+    uint32_t cache = ctx->settings.vertexCacheSize;
+    if(stripe == 0) {
+        INFO("Vertex cache tuning disabled (vertexCache=%u)\n", cache);
+        return;
+    }
+
+    INFO("Vertex cache, %ux%u grid, ACMR with a %u entry cache (0.5 is ideal for a grid)\n", width, height, cache);
+    for(uint32_t i = 0; i < ARR_LEN(names); i++) {
+        float acmr[2][2];
+        for(uint32_t s = 0; s < 2; s++) {
+            uint32_t count = meshIndexCount((MeshLayout)i, width, height, s ? stripe : 0);
+            uint32_t* indices = malloc(count * sizeof(uint32_t));
+            meshBuildIndices((MeshLayout)i, width, height, s ? stripe : 0, indices);
+            acmr[s][0] = meshSimulateACMR((MeshLayout)i, indices, count, cache, false);
+            acmr[s][1] = meshSimulateACMR((MeshLayout)i, indices, count, cache, true);
+            free(indices);
+        }
+        INFO("  %-6s rows     FIFO %.3f LRU %.3f\n", names[i], acmr[0][0], acmr[0][1]);
+        INFO("  %-6s stripes  FIFO %.3f LRU %.3f (%u quads wide)\n", names[i], acmr[1][0], acmr[1][1], stripe);
+    }
+}
+
+// Error tree build & triangulation times of the adaptive mesh at a few thresholds
+void benchRtin(Ctx* ctx) {
+    if(!ctx->data)
+        return;
+
+    uint32_t width = ctx->settings.gridWidth;
+    uint32_t height = ctx->settings.gridHeight;
+    uint32_t full = (width - 1) * (height - 1) * 2;
+    RtinTree tree;
+
+    double start = glfwGetTime();
+    if(!rtinBuild(&tree, ctx->data, width, height, (float)ctx->settings.maxHeight / 255.0f))
+        return;
+    double build = glfwGetTime() - start;
+
+    INFO("Adaptive mesh, %ux%u grid (%u triangles), error tree built in %.2f ms\n", width, height, full, build * 1000.0);
+    float errors[] = { 0.1f, 0.25f, 0.5f, 1.0f, 2.0f, 4.0f };
+    for(uint32_t i = 0; i < ARR_LEN(errors); i++) {
+        RtinMesh mesh;
+        start = glfwGetTime();
+        rtinExtract(&tree, errors[i], &mesh);
+        double extract = glfwGetTime() - start;
+        INFO("  error %5.2f %10u triangles (%5.1f%%) %8u vertices in %7.2f ms\n",
+             errors[i], mesh.indexCount / 3, 100.0 * mesh.indexCount / 3 / full, mesh.vertexCount, extract * 1000.0);
+        rtinFreeMesh(&mesh);
+    }
+
+    rtinDestroy(&tree);
+}
+
+// Simplification throughput on multi million triangle grids, down to a quarter of the triangles
+void benchQem(Ctx* ctx) {
+    uint32_t sizes[] = { 1025, 2049 };
+    int gridWidth = ctx->settings.gridWidth;
+    int gridHeight = ctx->settings.gridHeight;
+
+    INFO("QEM simplification on %u threads\n", jobsThreadCount());
+    for(uint32_t i = 0; i < ARR_LEN(sizes); i++) {
+        GenPass pass = { 1, ctx->settings.octaves };
+        uint32_t* heights = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, sizes[i], sizes[i], 0);
+
+        ctx->settings.gridWidth = ctx->settings.gridHeight = (int)sizes[i];
+        float* positions = terrainPositions(ctx, heights);
+        uint32_t count = meshIndexCount(MESH_LAYOUT_LIST, sizes[i], sizes[i], 0);
+        uint32_t* indices = malloc(count * sizeof(uint32_t));
+        meshBuildIndices(MESH_LAYOUT_LIST, sizes[i], sizes[i], 0, indices);
+
+        QemSettings settings = { .targetTriangles = count / 3 / 4 };
+        QemMesh mesh;
+        double start = glfwGetTime();
+        if(qemSimplify(positions, sizes[i] * sizes[i], indices, count, &settings, &mesh)) {
+            double elapsed = glfwGetTime() - start;
+            INFO("  %4ux%-4u %9u -> %9u triangles in %8.2f ms, %6.2f M triangles/s\n",
+                 sizes[i], sizes[i], count / 3, mesh.indexCount / 3, elapsed * 1000.0, count / 3 / elapsed / 1e6);
+            qemFreeMesh(&mesh);
+        }
+
+        free(indices);
+        free(positions);
+        free(heights);
+    }
+
+    ctx->settings.gridWidth = gridWidth;
+    ctx->settings.gridHeight = gridHeight;
+}
+
+// Ray casts against the min/max quadtree of a 4097x4097 heightmap, one at a time & batched on
+// every thread. The rays start above the terrain and look down at it like a camera would.
+void benchRaycast(Ctx* ctx) {
+    uint32_t size = 4097;
+    GenPass pass = { 1, ctx->settings.octaves };
+    uint32_t* heights = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, size, size, 0);
+
+    HeightTree tree;
+    double start = glfwGetTime();
+    bool ok = heightTreeBuild(&tree, heights, size, size, (float)ctx->settings.maxHeight / 255.0f);
+    double build = glfwGetTime() - start;
+    free(heights);
+    if(!ok)
+        return;
+
+    uint32_t count = 1 << 20;
+    Ray* rays = malloc(count * sizeof(Ray));
+    RayHit* hits = malloc(count * sizeof(RayHit));
+    srand(1);
+    for(uint32_t i = 0; i < count; i++) {
+        float angle = (float)rand() / RAND_MAX * 2.0f * PI;
+        float pitch = -(0.05f + 0.45f * (float)rand() / RAND_MAX);
+        rays[i] = (Ray){
+            .origin = { (float)(rand() % size), ctx->settings.maxHeight + 10.0f, (float)(rand() % size) },
+            .dir = { cosf(angle) * cosf(pitch), sinf(pitch), sinf(angle) * cosf(pitch) },
+            .maxT = 2.0f * size
+        };
+    }
+
+    start = glfwGetTime();
+    uint32_t hitCount = 0;
+    for(uint32_t i = 0; i < count; i++)
+        hitCount += heightTreeRaycast(&tree, &rays[i], &hits[i]);
+    double single = glfwGetTime() - start;
+
+    start = glfwGetTime();
+    heightTreeRaycastBatch(&tree, rays, count, hits);
+    double batch = glfwGetTime() - start;
+
+    INFO("Ray casting, %ux%u grid, %u levels built in %.2f ms, %u rays (%u hit)\n", size, size, tree.levelCount, build * 1000.0, count, hitCount);
+    INFO("  one by one %8.2f M rays/s\n", count / single / 1e6);
+    INFO("  batched    %8.2f M rays/s (%u threads)\n", count / batch / 1e6, jobsThreadCount());
+
+    free(hits);
+    free(rays);
+    heightTreeDestroy(&tree);
+}
+
+// Viewsheds on a 4097x4097 heightmap from the centre & a corner, standing on the ground &
+// high above it where most of the map has to be swept. Each is checked against exact line
+// of sight tests to random points.
+void benchViewshed(Ctx* ctx) {
+    uint32_t size = 4097;
+    GenPass pass = { 1, ctx->settings.octaves };
+    uint32_t* heights = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, size, size, 0);
+    HeightTree tree;
+    bool ok = heightTreeBuild(&tree, heights, size, size, (float)ctx->settings.maxHeight / 255.0f);
+    uint8_t* mask = malloc((size_t)size * size);
+    if(!ok || !mask) {
+        ERROR("Out of memory for the viewshed benchmark!\n");
+        heightTreeDestroy(&tree);
+        free(mask);
+        free(heights);
+        return;
+    }
+
+    INFO("Viewshed, %ux%u grid (%u threads)\n", size, size, jobsThreadCount());
+    uint32_t observers[2][2] = { { size / 2, size / 2 }, { 0, 0 } };
+    float observerHeights[2] = { VIEWSHED_OBSERVER_HEIGHT, (float)ctx->settings.maxHeight };
+    for(uint32_t o = 0; o < 4; o++) {
+        uint32_t x = observers[o / 2][0], z = observers[o / 2][1];
+        float observerHeight = observerHeights[o % 2];
+        double start = glfwGetTime();
+        uint64_t seen = viewshedCompute(&tree, x, z, observerHeight, 0.0f, mask);
+        double time = glfwGetTime() - start;
+
+        uint32_t samples = 100000, agree = 0;
+        float eye[3] = { (float)x, tree.heights[(size_t)z * size + x] * tree.unitHeight + observerHeight, (float)z };
+        srand(1);
+        for(uint32_t i = 0; i < samples; i++) {
+            uint32_t tx = rand() % size, tz = rand() % size;
+            float target[3] = { (float)tx, tree.heights[(size_t)tz * size + tx] * tree.unitHeight, (float)tz };
+            agree += heightTreeLineOfSight(&tree, eye, target) == (mask[(size_t)tz * size + tx] != 0);
+        }
+        INFO("  from (%4u, %4u), %5.1f up  %8.2f ms, %6.2f%% seen, agrees with line of sight on %6.2f%%\n",
+             x, z, observerHeight, time * 1000.0, 100.0 * seen / ((double)size * size), 100.0 * agree / samples);
+    }
+
+    free(mask);
+    heightTreeDestroy(&tree);
+    free(heights);
+}
+
+// Full horizon bakes of 1025x1025 & 2049x2049 heightmaps, then a re-bake after raising a
+// 33x33 block in the middle, which only sweeps the lines through it
+void benchHorizonBake(Ctx* ctx) {
+    uint32_t sizes[2] = { 1025, 2049 };
+    float sun[3] = { LIGHT_POS };
+    INFO("Horizon bake, %u directions (%u threads)\n", HORIZON_DIRECTIONS, jobsThreadCount());
+    for(uint32_t i = 0; i < ARR_LEN(sizes); i++) {
+        uint32_t size = sizes[i];
+        GenPass pass = { 1, ctx->settings.octaves };
+        uint32_t* heights = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, size, size, 0);
+        HorizonBake bake;
+        if(!horizonBakeInit(&bake, size, size, 1.0f, (float)ctx->settings.maxHeight / 255.0f, sun)) {
+            ERROR("Out of memory for the horizon bake benchmark!\n");
+            free(heights);
+            return;
+        }
+
+        double start = glfwGetTime();
+        horizonBakeUpdate(&bake, heights, 0, 0, size - 1, size - 1);
+        double full = glfwGetTime() - start;
+
+        uint32_t x0 = size / 2 - 16, z0 = size / 2 - 16;
+        for(uint32_t z = z0; z < z0 + 33; z++) {
+            for(uint32_t x = x0; x < x0 + 33; x++) {
+                uint32_t* texel = &heights[(size_t)z * size + x];
+                uint32_t raised = (*texel & 0xff) + 32 > 255 ? 255 : (*texel & 0xff) + 32;
+                *texel = (*texel & ~0xffu) | raised;
+            }
+        }
+        start = glfwGetTime();
+        horizonBakeUpdate(&bake, heights, x0, z0, x0 + 32, z0 + 32);
+        double edit = glfwGetTime() - start;
+
+        uint32_t dirty = bake.dirtyX0 <= bake.dirtyX1 ? (bake.dirtyX1 - bake.dirtyX0 + 1) * (bake.dirtyZ1 - bake.dirtyZ0 + 1) : 0;
+        INFO("  %4ux%-4u full %8.2f ms, 33x33 edit %8.2f ms re-uploading %5.2f%% of the texture\n",
+             size, size, full * 1000.0, edit * 1000.0, 100.0 * dirty / ((double)size * size));
+        horizonBakeDestroy(&bake);
+        free(heights);
+    }
+}
+
+// Bilinear height queries at random points of a 4097x4097 heightmap, one at a time & batched
+void benchHeightQuery(Ctx* ctx) {
+    uint32_t size = 4097;
+    GenPass pass = { 1, ctx->settings.octaves };
+    uint32_t* heights = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, size, size, 0);
+    HeightField field;
+    heightFieldInit(&field, heights, size, size, (float)ctx->settings.maxHeight / 255.0f);
+
+    uint32_t count = 1 << 22;
+    float* xs = malloc(count * sizeof(float));
+    float* zs = malloc(count * sizeof(float));
+    float* out = malloc(count * sizeof(float));
+    float* normals = malloc(3 * (size_t)count * sizeof(float));
+    srand(1);
+    for(uint32_t i = 0; i < count; i++) {
+        xs[i] = ((float)rand() / RAND_MAX - 0.5f) * size;
+        zs[i] = ((float)rand() / RAND_MAX - 0.5f) * size;
+    }
+
+    double times[3];
+    double start = glfwGetTime();
+    for(uint32_t i = 0; i < count; i++)
+        out[i] = heightFieldSample(&field, xs[i], zs[i], 0);
+    times[0] = glfwGetTime() - start;
+    start = glfwGetTime();
+    heightFieldQuery(&field, xs, zs, count, out, 0);
+    times[1] = glfwGetTime() - start;
+    start = glfwGetTime();
+    heightFieldQuery(&field, xs, zs, count, out, normals);
+    times[2] = glfwGetTime() - start;
+
+    INFO("Height queries, %ux%u grid, %u random points\n", size, size, count);
+    INFO("  one by one         %8.2f M points/s\n", count / times[0] / 1e6);
+    INFO("  batched            %8.2f M points/s (%u threads)\n", count / times[1] / 1e6, jobsThreadCount());
+    INFO("  batched + normals  %8.2f M points/s\n", count / times[2] / 1e6);
+
+    free(normals);
+    free(out);
+    free(zs);
+    free(xs);
+    free(heights);
+}
+
+// Replays a scripted walk over a 1025x1025 heightmap once tick by tick & once through frames
+// of random length, the camera has to end up at the exact same spot both times
+void benchCameraReplay(Ctx* ctx) {
+    uint32_t size = 1025;
+    GenPass pass = { 1, ctx->settings.octaves };
+    uint32_t* heights = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, size, size, 0);
+    HeightField ground;
+    heightFieldInit(&ground, heights, size, size, (float)ctx->settings.maxHeight / 255.0f);
+
+    // A minute of input that changes every quarter second
+    uint32_t ticks = 60 * CAMERA_TICK_RATE;
+    CameraInput* script = malloc(ticks * sizeof(CameraInput));
+    srand(1);
+    CameraInput input = { 0 };
+    for(uint32_t i = 0; i < ticks; i++) {
+        if(i % (CAMERA_TICK_RATE / 4) == 0) {
+            input.moves = rand() & 63;
+            input.yaw = (float)rand() / RAND_MAX * 360.0f;
+            input.pitch = ((float)rand() / RAND_MAX - 0.5f) * 120.0f;
+        }
+        script[i] = input;
+    }
+
+    Camera start = ctx->camera;
+    start.pos = vec3Create(0, 0, 0);
+    start.prevPos = start.pos;
+    start.accumulator = 0.0;
+
+    Camera direct = start;
+    double begin = glfwGetTime();
+    for(uint32_t i = 0; i < ticks; i++)
+        cameraTick(&direct, &script[i], &ground);
+    double time = glfwGetTime() - begin;
+
+    // Anything from 500 to 30 frames a second
+    Camera paced = start;
+    uint32_t done = 0, frames = 0;
+    while(done < ticks) {
+        double frameTime = 0.002 + (double)rand() / RAND_MAX * 0.031;
+        for(uint32_t steps = cameraSteps(&paced, frameTime); steps > 0 && done < ticks; steps--)
+            cameraTick(&paced, &script[done++], &ground);
+        frames++;
+    }
+
+    bool same = memcmp(&direct.pos, &paced.pos, sizeof(Vec3)) == 0;
+    INFO("Camera replay, %u ticks walking over a %ux%u grid\n", ticks, size, size);
+    INFO("  %8.4f us/tick\n", time * 1e6 / ticks);
+    INFO("  %u random frames end at (%.3f, %.3f, %.3f) :- %s\n", frames,
+         paced.pos.x, paced.pos.y, paced.pos.z, same ? "same as tick by tick" : "DIFFERENT");
+
+    free(script);
+    free(heights);
+}
+
+// Normal map of a 2049x2049 heightmap with SSE2 against packing every texel's normal like the
+// vertex buffers do, then frames shaded with per vertex & per fragment normals. Run with
+// LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe, where the vertex shader's 4 extra fetches cost the most.
+void benchNormalMap(Ctx* ctx) {
+    uint32_t size = 2049;
+    float unitHeight = (float)ctx->settings.maxHeight / 255.0f;
+    GenPass pass = { 1, ctx->settings.octaves };
+    uint32_t* heights = generatePass(&ctx->program, &ctx->warp, ctx->gen.seed, pass, size, size, 0);
+    NormalMap map;
+    if(!normalMapInit(&map, size, size, 1.0f, unitHeight)) {
+        ERROR("Out of memory for the normal map benchmark!\n");
+        free(heights);
+        return;
+    }
+
+    double start = glfwGetTime();
+    normalMapUpdate(&map, heights, 0, 0, size - 1, size - 1);
+    double simd = glfwGetTime() - start;
+    start = glfwGetTime();
+    for(uint32_t z = 0; z < size; z++) {
+        for(uint32_t x = 0; x < size; x++)
+            packNormal(heights, size, size, x, z, unitHeight, 1.0f, (int8_t*)&map.texels[(size_t)z * size + x]);
+    }
+    double scalar = glfwGetTime() - start;
+    INFO("Normal map, %ux%u grid\n", size, size);
+    INFO("  SSE2 (%u threads) %8.2f ms\n", jobsThreadCount(), simd * 1000.0);
+    INFO("  per texel         %8.2f ms\n", scalar * 1000.0);
+    normalMapDestroy(&map);
+    free(heights);
+
+    if(!ctx->normalMap.texels)
+        return;
+    uint32_t frames = 20;
+    bool useNormalMap = ctx->useNormalMap;
+    INFO("Normals, %ux%u grid, %u frames on %s\n", ctx->settings.gridWidth, ctx->settings.gridHeight, frames, glGetString(GL_RENDERER));
+    for(uint32_t i = 0; i < 2; i++) {
+        ctx->useNormalMap = i == 1;
+        INFO("  %-12s %8.2f ms/frame\n", i == 1 ? "per fragment" : "per vertex", timeFrames(ctx, frames));
+    }
+    ctx->useNormalMap = useNormalMap;
+}
+
+// A stroke of every brush circling the middle of the terrain twice, one dab per 60Hz frame. Times the dab
+// itself, updating & uploading what it changed (waiting for the GPU), ending the stroke on the
+// render thread and until the catch-up thread's work is swapped in. Run with width=4097 height=4097 for a 4k map.
+void benchSculpt(Ctx* ctx) {
+    if(!ctx->data || !ctx->heightTree.levelCount) {
+        INFO("Sculpting, no heightmap on the CPU\n");
+        return;
+    }
+
+    uint32_t width = ctx->settings.gridWidth, height = ctx->settings.gridHeight;
+    uint32_t dabs = 240;
+    const char* names[3] = { "raise", "lower", "smooth" };
+    SculptBrush brush = ctx->brush;
+    struct timespec wait = { 0, 1000000 };
+    INFO("Sculpting, %ux%u grid, radius %.1f, %u dabs per stroke on %s\n", width, height, ctx->brush.radius, dabs, glGetString(GL_RENDERER));
+    for(uint32_t tool = 0; tool < 3; tool++) {
+        ctx->brush.tool = (SculptTool)tool;
+        double dab = 0.0, update = 0.0, worst = 0.0;
+        for(uint32_t i = 0; i < dabs; i++) {
+            float angle = 2.0f * 6.2831853f * i / dabs;
+            float x = (width - 1) / 2.0f + 4.0f * ctx->brush.radius * cosf(angle);
+            float z = (height - 1) / 2.0f + 4.0f * ctx->brush.radius * sinf(angle);
+
+            double start = glfwGetTime();
+            sculptDab(ctx->data, width, height, &ctx->brush, x, z, 1.0f / 60.0f, i, &ctx->editRect);
+            ctx->strokeDabs++;
+            dab += glfwGetTime() - start;
+
+            start = glfwGetTime();
+            uploadTerrainEdits(ctx);
+            glFinish();
+            double time = glfwGetTime() - start;
+            update += time;
+            worst = time > worst ? time : worst;
+        }
+        double upload = ctx->strokeUpload;
+        double start = glfwGetTime();
+        finishStroke(ctx);
+        glFinish();
+        double finish = glfwGetTime() - start;
+        while(ctx->catchUp.running) {
+            nanosleep(&wait, 0);
+            pollCatchUp(ctx);
+        }
+        glFinish();
+        double caughtUp = glfwGetTime() - start;
+        INFO("  %-6s %7.3f ms dab, %7.3f ms update (%.3f ms upload calls, worst frame %.3f ms), %6.2f ms end of stroke, caught up after %8.2f ms\n",
+             names[tool], dab * 1000.0 / dabs, update * 1000.0 / dabs, upload * 1000.0 / dabs, worst * 1000.0, finish * 1000.0, caughtUp * 1000.0);
+    }
+    ctx->brush = brush;
+}
+
+// CPU time to submit the visible chunks one by one & with one indirect call,
+// more chunks (a larger width & height) make the difference clearer
+void benchDrawSubmission(Ctx* ctx) {
+    const char* names[] = { "loop", "indirect" };
+    bool available = ctx->indirect.available;
+    uint32_t frames = 100;
+
+    INFO("Chunk submission, %u chunks, %u frames on %s\n", ctx->chunkCount, frames, glGetString(GL_RENDERER));
+    for(uint32_t i = 0; i < ARR_LEN(names); i++) {
+        if(i == 1 && !available) {
+            INFO("  %-8s unavailable\n", names[i]);
+            break;
+        }
+        ctx->indirect.available = i == 1;
+
+        double submit = 0.0;
+        for(uint32_t f = 0; f < frames; f++) {
+            drawTerrain(ctx);
+            submit += ctx->submitTime;
+        }
+        glFinish();
+
+        double ms = timeFrames(ctx, frames / 5);
+        INFO("  %-8s %5u visible chunks in %5u draw calls, %8.4f ms submit, %8.2f ms/frame\n",
+             names[i], ctx->drawCount, ctx->drawCalls, submit * 1000.0 / frames, ms);
+    }
+    ctx->indirect.available = available;
+}
+
+// Time until the first frame is drawn with & without progressive generation, and until the full
+// resolution terrain is in. Runs last since it regenerates the terrain, use a large grid (e.g.
+// width=4097 height=4097) to see the difference.
+void benchProgressive(Ctx* ctx) {
+    const char* names[] = { "up front", "progressive" };
+    bool progressive = ctx->settings.progressive;
+    struct timespec wait = { 0, 1000000 };
+
+    INFO("Progressive generation, %ux%u grid\n", ctx->settings.gridWidth, ctx->settings.gridHeight);
+    for(uint32_t i = 0; i < ARR_LEN(names); i++) {
+        ctx->settings.progressive = i == 1;
+        double start = glfwGetTime();
+        startGeneration(ctx);
+        double generated = glfwGetTime();
+        double first = (generated - start) * 1000.0 + timeFrames(ctx, 1);
+        // Without the offscreen frames, which only the first needs
+        double drawing = glfwGetTime() - generated;
+        while(ctx->gen.running) {
+            nanosleep(&wait, 0);
+            pollGeneration(ctx);
+        }
+        double full = (glfwGetTime() - start - drawing) * 1000.0;
+        INFO("  %-11s first frame after %8.2f ms, full resolution after %8.2f ms\n", names[i], first, full);
+    }
+    ctx->settings.progressive = progressive;
+}
+
+void runBenchmarks(Ctx* ctx) {
+    benchNoiseBackends(ctx);
+    benchGpuGen(ctx);
+    benchPyramid(ctx);
+    benchVertexCache(ctx);
+    benchMeshLayouts(ctx);
+    benchRtin(ctx);
+    benchQem(ctx);
+    benchRaycast(ctx);
+    benchViewshed(ctx);
+    benchHorizonBake(ctx);
+    benchNormalMap(ctx);
+    benchHeightQuery(ctx);
+    benchCameraReplay(ctx);
+    benchDrawSubmission(ctx);
+    benchSculpt(ctx);
+    benchProgressive(ctx);
+}
+
+// The compute shader only knows the default fbm
+bool canUseGpuGen(const Ctx* ctx) {
+    const Settings* s = &ctx->settings;
+    return !s->noise && !s->noiseFile && s->cellWeight <= 0.0f && s->warpStrength == 0.0f && !s->fixedPoint && strcmp(s->noiseBackend, "perlin") == 0;
+}
+
+void createGpuGen(Ctx* ctx) {
+    if(!ctx->settings.compute)
+        return;
+
+    const char* source = readFile("shaders/heightmap.comp");
+    bool ok = gpuGenInit(&ctx->gpuGen, source);
+    free((void*)source);
+
+    if(!ok) {
+        ERROR("Falling back to generating the heightmap on the CPU!\n");
+        ctx->settings.compute = false;
+    } else if(!canUseGpuGen(ctx)) {
+        ERROR("The compute shader only supports the default fbm, generating on the CPU!\n");
+        ctx->settings.compute = false;
+    }
 }
 
 int main(int argc, const char** argv) {
@@ -433,6 +2919,13 @@ int main(int argc, const char** argv) {
     };
 
     parseArgs(&ctx.settings, argc, argv);
+    ctx.rtinError = ctx.settings.rtinError;
+    ctx.brush = (SculptBrush){ SCULPT_RAISE, ctx.settings.brushRadius, ctx.settings.brushStrength };
+    dirtyRectReset(&ctx.editRect);
+    dirtyRectReset(&ctx.strokeRect);
+    if(!createNoiseProgram(&ctx))
+        exit(1);
+    jobsInit(ctx.settings.threads);
 
     // Init
     {
@@ -442,12 +2935,19 @@ int main(int argc, const char** argv) {
                 ERROR("Couldnt't init glfw!\n");
                 exit(1);
             }
-            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            // Compute & tessellation shaders need 4.x, everything else runs on 3.3
+            bool compute = ctx.settings.compute || ctx.settings.tessellation;
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, compute ? 4 : 3);
             glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
             glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
             glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
             ctx.window = glfwCreateWindow(ctx.width, ctx.height, "PerlinTerrain", 0, 0);
+            if(!ctx.window && compute) {
+                ERROR("Couldn't create a GL 4.3 context, retrying with 3.3!\n");
+                glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+                ctx.window = glfwCreateWindow(ctx.width, ctx.height, "PerlinTerrain", 0, 0);
+            }
             if(!ctx.window) {
                 ERROR("Couldn't create glfw window!\n");
                 exit(1);
@@ -458,12 +2958,6 @@ int main(int argc, const char** argv) {
                 exit(1);
             }
         }
-        //Height map 
-        {
-            ctx.data = malloc(ctx.settings.gridHeight * ctx.settings.gridWidth * sizeof(uint32_t));
-            memset(ctx.data, 0, sizeof(uint32_t) * ctx.settings.gridHeight * ctx.settings.gridWidth);
-            getHeight(ctx.settings.octaves, ctx.settings.gridWidth, ctx.settings.gridHeight, ctx.data);
-        }
         // Texture 
         {
             glGenTextures(1, &ctx.tex);
@@ -474,45 +2968,57 @@ int main(int argc, const char** argv) {
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ctx.settings.gridWidth, ctx.settings.gridHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, ctx.data);
-
-            glGenerateMipmap(GL_TEXTURE_2D);
+            uint32_t textures[3];
+            glGenTextures(3, textures);
+            ctx.viewshedTex = textures[0];
+            ctx.bakeTex = textures[1];
+            ctx.normalTex = textures[2];
+            for(uint32_t i = 0; i < 3; i++) {
+                glBindTexture(GL_TEXTURE_2D, textures[i]);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
 
             glBindTexture(GL_TEXTURE_2D, 0);
         }
+        //Height map & buffers, the benchmarks need the full terrain right away
+        {
+            createGpuGen(&ctx);
+            indirectInit(&ctx.indirect, ctx.settings.indirect);
+            createTess(&ctx);
+            if(ctx.settings.benchmark)
+                ctx.settings.progressive = false;
+            startGeneration(&ctx);
+        }
         //Shader
         if(!createShader(&ctx, &ctx.shader))
             exit(1);
-        // Buffers 
-        createTerrain(&ctx);
         // Camera
         createCamera(&ctx);
     }
 
+    if(ctx.settings.benchmark) {
+        runBenchmarks(&ctx);
+        glfwSetWindowShouldClose(ctx.window, GLFW_TRUE);
+    }
+
     //Main loop
-    glfwShowWindow(ctx.window);
+    if(!ctx.settings.benchmark)
+        glfwShowWindow(ctx.window);
     glViewport(0, 0, ctx.width, ctx.height);
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     while(!glfwWindowShouldClose(ctx.window)) {
+        // Edits go up before the frame draws from the buffers they touch, so they show right away
+        sculptTerrain(&ctx);
+
         // Render
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glUseProgram(ctx.shader);
-        putMat4Shader(ctx.shader, "u_Proj", ctx.camera.proj);
-        putMat4Shader(ctx.shader, "u_View", ctx.camera.view);
-        glUniform2f(glGetUniformLocation(ctx.shader, "u_TexRes"), (float)ctx.settings.gridWidth, (float)ctx.settings.gridHeight);
-        glUniform1f(glGetUniformLocation(ctx.shader, "u_MaxHeight"), (float)ctx.settings.maxHeight);
-        glUniform1f(glGetUniformLocation(ctx.shader, "u_Ambient"), 0.01f);
-        glUniform3f(glGetUniformLocation(ctx.shader, "u_LightPos"), 1000.0f, 1000.0f, 0.0f);
-        
-        glBindTexture(GL_TEXTURE_2D, ctx.tex);
-        glActiveTexture(GL_TEXTURE0);
-        glUniform1i(glGetUniformLocation(ctx.shader, "u_Tex"), 0);
-
-        glBindVertexArray(ctx.vao);
-        glDrawElements(GL_TRIANGLES, ctx.count, GL_UNSIGNED_INT, 0);
+        drawTerrain(&ctx);
         
         // Update
         if(glfwGetKey(ctx.window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
@@ -524,6 +3030,33 @@ int main(int argc, const char** argv) {
                 glDeleteProgram(ctx.shader);
                 ctx.shader = id;
             }
+            if(ctx.tess.available) {
+                // Keeps whichever of the patches & the mesh 'T' picked, as long as the patches still link
+                bool useTess = ctx.useTess;
+                tessDestroy(&ctx.tess);
+                createTess(&ctx);
+                ctx.useTess = useTess && ctx.tess.available;
+            }
+        }
+        // 'T' switches between the tessellated patches & the mesh
+        {
+            static bool wasPressed = false;
+            bool pressed = glfwGetKey(ctx.window, GLFW_KEY_T) == GLFW_PRESS;
+            if(pressed && !wasPressed && ctx.tess.available) {
+                ctx.useTess = !ctx.useTess;
+                INFO("Drawing the %s\n", ctx.useTess ? "tessellated patches" : "mesh");
+            }
+            wasPressed = pressed;
+        }
+        // 'F' switches between flying & walking on the terrain
+        {
+            static bool wasPressed = false;
+            bool pressed = glfwGetKey(ctx.window, GLFW_KEY_F) == GLFW_PRESS;
+            if(pressed && !wasPressed) {
+                ctx.camera.walk = !ctx.camera.walk;
+                INFO("%s\n", ctx.camera.walk ? "Walking" : "Flying");
+            }
+            wasPressed = pressed;
         }
         if(glfwGetKey(ctx.window, GLFW_KEY_G) == GLFW_PRESS) {
             static double lastTimeG = 0.0;
@@ -533,18 +3066,34 @@ int main(int argc, const char** argv) {
             if(dt < ctx.settings.terrainGenCooldown) {
                 ERROR("Wait for cooldown,%.2fs left!\n", ctx.settings.terrainGenCooldown - dt);
             } else {
-                free(ctx.data);
-            
-                ctx.data = malloc(ctx.settings.gridWidth * ctx.settings.gridHeight * sizeof(uint32_t));
-                memset(ctx.data, 0, sizeof(uint32_t) * ctx.settings.gridWidth * ctx.settings.gridHeight);
-                getHeight(ctx.settings.octaves, ctx.settings.gridWidth, ctx.settings.gridHeight, ctx.data);
-            
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ctx.settings.gridWidth, ctx.settings.gridHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, ctx.data);
-                
-                glDeleteBuffers(1, &ctx.ebo);
-                glDeleteBuffers(1, &ctx.vbo);
-                glDeleteVertexArrays(1, &ctx.vao);
-                createTerrain(&ctx);
+                startGeneration(&ctx);
+            }
+        }
+        // Left click picks the terrain under the cursor
+        {
+            static bool wasPressed = false;
+            bool pressed = glfwGetMouseButton(ctx.window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+            if(pressed && !wasPressed)
+                pickTerrain(&ctx);
+            wasPressed = pressed;
+        }
+        // 'V' shows what can be seen from the terrain point under the cursor
+        {
+            static bool wasPressed = false;
+            bool pressed = glfwGetKey(ctx.window, GLFW_KEY_V) == GLFW_PRESS;
+            if(pressed && !wasPressed)
+                placeObserver(&ctx);
+            wasPressed = pressed;
+        }
+        // '1', '2' & '3' pick the raising, lowering & smoothing brush
+        {
+            int keys[3] = { GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3 };
+            const char* names[3] = { "Raising", "Lowering", "Smoothing" };
+            for(uint32_t i = 0; i < 3; i++) {
+                if(glfwGetKey(ctx.window, keys[i]) == GLFW_PRESS && ctx.brush.tool != (SculptTool)i) {
+                    ctx.brush.tool = (SculptTool)i;
+                    INFO("%s the terrain with 'E'\n", names[i]);
+                }
             }
         }
         if(glfwGetKey(ctx.window, GLFW_KEY_B) == GLFW_PRESS) {
@@ -552,6 +3101,19 @@ int main(int argc, const char** argv) {
         } else if(glfwGetKey(ctx.window, GLFW_KEY_B) == GLFW_RELEASE) {
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
+        // '[' & ']' halve & double the error of the adaptive mesh
+        {
+            static bool wasPressed = false;
+            bool finer = glfwGetKey(ctx.window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS;
+            bool coarser = glfwGetKey(ctx.window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS;
+            if((finer || coarser) && !wasPressed && ctx.rtinHeights && ctx.rtinHeights == ctx.data) {
+                ctx.rtinError *= finer ? 0.5f : 2.0f;
+                destroyTerrain(&ctx);
+                remeshTerrain(&ctx);
+                INFO("Adaptive mesh error %.3f :- %u triangles\n", ctx.rtinError, ctx.count / 3);
+            }
+            wasPressed = finer || coarser;
+        }
         glfwGetCursorPos(ctx.window, &ctx.mouseX, &ctx.mouseY);
         glfwGetWindowSize(ctx.window, &ctx.width, &ctx.height);
         glViewport(0, 0, ctx.width, ctx.height);
@@ -559,11 +3121,14 @@ int main(int argc, const char** argv) {
         double crntTime = glfwGetTime();
         ctx.deltaTime = crntTime - ctx.lastTime;
         ctx.lastTime = crntTime;
-        char title[100];
-        snprintf(title, sizeof(char) * 100, "PerlinTerrain | Delta time :- %.2fms | FPS :- %.2f", ctx.deltaTime * 1000, 1.0/ctx.deltaTime);
+        char title[160];
+        snprintf(title, sizeof(char) * 160, "PerlinTerrain | Delta time :- %.2fms | FPS :- %.2f | Chunks :- %u in %u draws, %.3fms submit",
+                 ctx.deltaTime * 1000, 1.0/ctx.deltaTime, ctx.drawCount, ctx.drawCalls, ctx.submitTime * 1000.0);
         glfwSetWindowTitle(ctx.window, title);
 
         updateCamera(&ctx);
+        pollGeneration(&ctx);
+        pollCatchUp(&ctx);
 
         glfwSwapBuffers(ctx.window);
         glfwPollEvents();
@@ -571,18 +3136,30 @@ int main(int argc, const char** argv) {
 
     // Cleanup
     {
+        stopGeneration(&ctx);
+        stopCatchUp(&ctx);
         free(ctx.data);
 
         glDeleteTextures(1, &ctx.tex);
-
-        glDeleteBuffers(1, &ctx.ebo);
-        glDeleteBuffers(1, &ctx.vbo);
-        glDeleteVertexArrays(1, &ctx.vao);
+        glDeleteTextures(1, &ctx.viewshedTex);
+        glDeleteTextures(1, &ctx.bakeTex);
+        glDeleteTextures(1, &ctx.normalTex);
+
+        destroyTerrain(&ctx);
+        rtinDestroy(&ctx.rtin);
+        heightTreeDestroy(&ctx.heightTree);
+        horizonBakeDestroy(&ctx.bake);
+        normalMapDestroy(&ctx.normalMap);
+        gpuGenDestroy(&ctx.gpuGen);
+        indirectDestroy(&ctx.indirect);
+        tessDestroy(&ctx.tess);
 
         glDeleteProgram(ctx.shader);
 
         glfwDestroyWindow(ctx.window);
         glfwTerminate();
+
+        jobsShutdown();
     }
 
     return 0;
@@ -0,0 +1,185 @@
+#include "mesh.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t stripeCount(uint32_t width, uint32_t stripe) {
+    return stripe == 0 ? 1 : (width - 1 + stripe - 1) / stripe;
+}
+
+uint32_t meshIndexCount(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe) {
+    if(width < 2 || height < 2)
+        return 0;
+    if(layout == MESH_LAYOUT_STRIP) {
+        // Every stripe row is a strip of 2 indices per vertex, joined by restarts
+        uint32_t strips = stripeCount(width, stripe) * (height - 1);
+        uint32_t vertices = (width + stripeCount(width, stripe) - 1) * (height - 1);
+        return vertices * 2 + strips - 1;
+    }
+    return (width - 1) * (height - 1) * 6;
+}
+
+// Both layouts give the same triangles with the same winding,
+// (v0, v2, v1) & (v1, v2, v3) for a quad whose top left corner is v0
+void meshBuildIndices(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe, uint32_t* indices) {
+    uint32_t idx = 0;
+    uint32_t stripes = stripeCount(width, stripe);
+    uint32_t quads = stripe == 0 ? width - 1 : stripe;
+
+    for(uint32_t s = 0; s < stripes; s++) {
+        uint32_t x0 = s * quads;
+        uint32_t x1 = x0 + quads < width - 1 ? x0 + quads : width - 1;
+
+        for(uint32_t y = 0; y < height-1; y++) {
+            if(layout == MESH_LAYOUT_STRIP) {
+                if(idx > 0)
+                    indices[idx++] = MESH_RESTART_INDEX;
+                for(uint32_t x = x0; x <= x1; x++) {
+                    indices[idx++] = y * width + x;
+                    indices[idx++] = (y+1) * width + x;
+                }
+                continue;
+            }
+
+            for(uint32_t x = x0; x < x1; x++) {
+                uint32_t v0 = y * width + x;
+                uint32_t v1 = y * width + (x + 1);
+                uint32_t v2 = (y+1) * width + x;
+                uint32_t v3 = (y+1) * width + (x+1);
+
+                indices[idx++] = v0;
+                indices[idx++] = v2;
+                indices[idx++] = v1;
+                
+                indices[idx++] = v1;
+                indices[idx++] = v2;
+                indices[idx++] = v3;
+            }
+        }
+    }
+}
+
+float meshSimulateACMR(MeshLayout layout, const uint32_t* indices, uint32_t count, uint32_t cacheSize, bool lru) {
+    uint32_t* cache = malloc(cacheSize * sizeof(uint32_t));
+    uint32_t used = 0, head = 0;
+    uint32_t misses = 0, triangles = 0, stripLength = 0;
+
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t index = indices[i];
+        if(layout == MESH_LAYOUT_STRIP) {
+            if(index == MESH_RESTART_INDEX) {
+                stripLength = 0;
+                continue;
+            }
+            if(++stripLength >= 3)
+                triangles++;
+        }
+
+        uint32_t slot = used;
+        for(uint32_t c = 0; c < used; c++) {
+            if(cache[c] == index) {
+                slot = c;
+                break;
+            }
+        }
+
+        if(slot < used) {
+            // A hit only refreshes the entry with LRU, FIFO keeps the insertion order
+            if(lru) {
+                memmove(cache + 1, cache, slot * sizeof(uint32_t));
+                cache[0] = index;
+            }
+            continue;
+        }
+
+        misses++;
+        if(lru) {
+            uint32_t keep = used < cacheSize ? used : cacheSize - 1;
+            memmove(cache + 1, cache, keep * sizeof(uint32_t));
+            cache[0] = index;
+            used = keep + 1;
+        } else if(used < cacheSize) {
+            cache[used++] = index;
+        } else {
+            cache[head] = index;
+            head = (head + 1) % cacheSize;
+        }
+    }
+
+    if(layout == MESH_LAYOUT_LIST)
+        triangles = count / 3;
+
+    free(cache);
+    return triangles ? (float)misses / triangles : 0.0f;
+}
+
+static uint32_t chunksAlong(uint32_t size) {
+    return size < 2 ? 1 : (size - 1 + MESH_CHUNK_DIM - 2) / (MESH_CHUNK_DIM - 1);
+}
+
+uint32_t meshChunkCount(uint32_t width, uint32_t height) {
+    return chunksAlong(width) * chunksAlong(height);
+}
+
+void meshBuildChunks(uint32_t width, uint32_t height, MeshChunk* chunks) {
+    uint32_t cx = chunksAlong(width), cy = chunksAlong(height);
+    for(uint32_t y = 0; y < cy; y++) {
+        for(uint32_t x = 0; x < cx; x++) {
+            MeshChunk* c = &chunks[y * cx + x];
+            c->x = x * (MESH_CHUNK_DIM - 1);
+            c->y = y * (MESH_CHUNK_DIM - 1);
+            c->width = width - c->x < MESH_CHUNK_DIM ? width - c->x : MESH_CHUNK_DIM;
+            c->height = height - c->y < MESH_CHUNK_DIM ? height - c->y : MESH_CHUNK_DIM;
+        }
+    }
+}
+
+void meshNarrowIndices(const uint32_t* indices, uint32_t count, uint16_t* out) {
+    for(uint32_t i = 0; i < count; i++)
+        out[i] = indices[i] == MESH_RESTART_INDEX ? MESH_RESTART_INDEX16 : (uint16_t)indices[i];
+}
+
+// Vertices of a 'size' vertex row at 'step', the last one is always kept
+static uint32_t lodSize(uint32_t size, uint32_t step) {
+    return (size - 1 + step - 1) / step + 1;
+}
+
+static uint32_t lodCoord(uint32_t i, uint32_t size, uint32_t step) {
+    return i * step < size - 1 ? i * step : size - 1;
+}
+
+// Moves a coordinate the coarser level skips onto the nearest one it keeps, the previous
+// one on a tie. In the short last segment of odd sized chunks that is always the last
+// vertex, snapping back there could fold the corner over a snapped neighbouring edge.
+static uint32_t lodSnap(uint32_t coord, uint32_t size, uint32_t step) {
+    uint32_t previous = coord / (step * 2) * (step * 2);
+    return previous + step * 2 > size - 1 && coord != previous ? size - 1 : previous;
+}
+
+uint32_t meshLodIndexCount(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe, uint32_t level) {
+    uint32_t step = 1u << level;
+    return meshIndexCount(layout, lodSize(width, step), lodSize(height, step), stripe);
+}
+
+void meshBuildLodIndices(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe, uint32_t level, uint32_t edges, uint32_t* indices) {
+    uint32_t step = 1u << level;
+    uint32_t lodWidth = lodSize(width, step);
+    uint32_t lodHeight = lodSize(height, step);
+    uint32_t count = meshIndexCount(layout, lodWidth, lodHeight, stripe);
+    meshBuildIndices(layout, lodWidth, lodHeight, stripe, indices);
+
+    // The level is built as a small grid & mapped onto the chunk's vertices. Snapped
+    // vertices only slide along their edge, so the triangles they touch either keep
+    // their winding or collapse to nothing.
+    for(uint32_t i = 0; i < count; i++) {
+        if(indices[i] == MESH_RESTART_INDEX)
+            continue;
+        uint32_t x = lodCoord(indices[i] % lodWidth, width, step);
+        uint32_t y = lodCoord(indices[i] / lodWidth, height, step);
+        if(((edges & MESH_EDGE_LEFT) && x == 0) || ((edges & MESH_EDGE_RIGHT) && x == width - 1))
+            y = lodSnap(y, height, step);
+        if(((edges & MESH_EDGE_BOTTOM) && y == 0) || ((edges & MESH_EDGE_TOP) && y == height - 1))
+            x = lodSnap(x, width, step);
+        indices[i] = y * width + x;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ends a strip when GL_PRIMITIVE_RESTART is enabled
+#define MESH_RESTART_INDEX 0xFFFFFFFFu
+#define MESH_RESTART_INDEX16 0xFFFFu
+// Vertices per side of a chunk. Keeps every chunk local index below the 16 bit restart index,
+// and 2^n + 1 so every detail level of a full chunk is a regular grid.
+#define MESH_CHUNK_DIM 129
+// Detail levels of a chunk, level l uses every 2^l-th vertex of every row & column
+#define MESH_LOD_LEVELS 6
+
+typedef enum {
+    // 2 independent triangles per quad, 6 indices
+    MESH_LAYOUT_LIST,
+    // One strip per row of quads joined with the restart index, 2 indices per quad
+    MESH_LAYOUT_STRIP
+} MeshLayout;
+
+// Indices of a width x height vertex grid in the given layout. With a 'stripe'
+// of n > 0 the grid is walked in vertical stripes n quads wide, so a row of a
+// stripe reuses the vertices of the row above from the post-transform cache.
+// 0 walks whole rows.
+uint32_t meshIndexCount(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe);
+void meshBuildIndices(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe, uint32_t* indices);
+
+// Average cache miss ratio, vertex shader runs per triangle, of drawing the
+// indices through a post-transform cache of 'cacheSize' entries. GPUs have
+// used both FIFO & LRU replacement.
+float meshSimulateACMR(MeshLayout layout, const uint32_t* indices, uint32_t count, uint32_t cacheSize, bool lru);
+
+// Part of the vertex grid drawn with its own base vertex, neighbouring chunks share their border vertices
+typedef struct {
+    uint32_t x, y;
+    uint32_t width, height;
+} MeshChunk;
+
+uint32_t meshChunkCount(uint32_t width, uint32_t height);
+void meshBuildChunks(uint32_t width, uint32_t height, MeshChunk* chunks);
+// Converts chunk local indices to 16 bit, restart indices included
+void meshNarrowIndices(const uint32_t* indices, uint32_t count, uint16_t* out);
+
+// Edges of a chunk whose neighbour is one detail level coarser. Their vertices that the
+// neighbour skips are snapped onto the previous vertex it keeps, so both chunks share the
+// same edge and no cracks open between them. The 16 combinations are the stitch variants.
+typedef enum {
+    MESH_EDGE_LEFT = 1,
+    MESH_EDGE_RIGHT = 2,
+    MESH_EDGE_BOTTOM = 4,
+    MESH_EDGE_TOP = 8
+} MeshEdge;
+
+#define MESH_STITCH_VARIANTS 16
+
+// Indices of a detail level of a width x height chunk, the same for every stitch variant.
+// Level 0 is the full grid. Coarser levels keep the last row & column whatever the size,
+// so the vertices of a level are always a subset of the finer ones.
+uint32_t meshLodIndexCount(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe, uint32_t level);
+// 'edges' is a mask of MeshEdge, the indices address the chunk's full resolution vertices
+void meshBuildLodIndices(MeshLayout layout, uint32_t width, uint32_t height, uint32_t stripe, uint32_t level, uint32_t edges, uint32_t* indices);
@@ -0,0 +1,775 @@
+#include "noise.h"
+#include "common.h"
+#include "simd.h"
+
+#include <stb/stb_perlin.h>
+
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    NoiseOp op;
+    // Sub graphs taken before the numeric parameters, add & mul take any number >= 2
+    uint32_t inputs;
+    uint32_t minParams, maxParams;
+    float defaults[NOISE_MAX_PARAMS];
+} NoiseNode;
+
+// An octave default of -1 is replaced with the octaves from the settings
+static const NoiseNode nodes[] = {
+    { "perlin",     NOISE_OP_PERLIN,     0, 0, 1, { 1.0f } },                          // frequency
+    { "fbm",        NOISE_OP_FBM,        0, 0, 4, { -1, 2.0f, 0.5f, 1.0f } },          // octaves, lacunarity, gain, frequency
+    { "ridge",      NOISE_OP_RIDGE,      0, 0, 5, { -1, 2.0f, 0.5f, 1.0f, 1.0f } },    // octaves, lacunarity, gain, offset, frequency
+    { "turbulence", NOISE_OP_TURBULENCE, 0, 0, 4, { -1, 2.0f, 0.5f, 1.0f } },          // octaves, lacunarity, gain, frequency
+    { "cells",      NOISE_OP_CELLS,      0, 0, 3, { 1.0f, 0, 1.0f } },                 // frequency, mode (0 F1, 1 F2, 2 F2-F1), jitter
+    { "add",        NOISE_OP_ADD,        2, 0, 0, { 0 } },
+    { "mul",        NOISE_OP_MUL,        2, 0, 0, { 0 } },
+    { "clamp",      NOISE_OP_CLAMP,      1, 0, 2, { -1.0f, 1.0f } },                   // min, max
+    { "remap",      NOISE_OP_REMAP,      1, 4, 4, { 0 } },                             // inMin, inMax, outMin, outMax
+    { "warp",       NOISE_OP_WARP_PUSH,  3, 0, 1, { 1.0f } },                          // strength
+};
+
+typedef struct {
+    const char* src;
+    const char* cur;
+    NoiseProgram* program;
+    int defaultOctaves;
+    uint32_t depth;
+    uint32_t warpDepth;
+    bool ok;
+} Parser;
+
+static void parseError(Parser* p, const char* msg) {
+    if(p->ok)
+        ERROR("Noise graph :- %s (at offset %d)\n", msg, (int)(p->cur - p->src));
+    p->ok = false;
+}
+
+static void skipSpace(Parser* p) {
+    while(*p->cur) {
+        if(isspace((unsigned char)*p->cur)) {
+            p->cur++;
+        } else if(*p->cur == '#') {
+            while(*p->cur && *p->cur != '\n')
+                p->cur++;
+        } else {
+            break;
+        }
+    }
+}
+
+static bool accept(Parser* p, char c) {
+    skipSpace(p);
+    if(*p->cur != c)
+        return false;
+    p->cur++;
+    return true;
+}
+
+static void expect(Parser* p, char c) {
+    if(!accept(p, c)) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "Expected '%c'", c);
+        parseError(p, msg);
+    }
+}
+
+static bool peekNumber(Parser* p) {
+    skipSpace(p);
+    char c = *p->cur;
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+static float parseNumber(Parser* p) {
+    skipSpace(p);
+    char* end = 0;
+    float v = strtof(p->cur, &end);
+    if(end == p->cur) {
+        parseError(p, "Expected a number");
+        return 0.0f;
+    }
+    p->cur = end;
+    return v;
+}
+
+static void emit(Parser* p, NoiseOp op, const float* params) {
+    if(!p->ok)
+        return;
+    if(p->program->count >= NOISE_MAX_INSTRUCTIONS) {
+        parseError(p, "Graph is too large");
+        return;
+    }
+    NoiseInstr* instr = &p->program->code[p->program->count++];
+    memset(instr, 0, sizeof(NoiseInstr));
+    instr->op = op;
+    if(params)
+        memcpy(instr->params, params, sizeof(instr->params));
+}
+
+static void push(Parser* p, uint32_t n) {
+    p->depth += n;
+    if(p->depth > NOISE_MAX_STACK)
+        parseError(p, "Graph is nested too deeply");
+}
+
+// Moves the instructions [from, mid) behind [mid, count)
+static void rotateCode(NoiseProgram* program, uint32_t from, uint32_t mid) {
+    NoiseInstr tmp[NOISE_MAX_INSTRUCTIONS];
+    uint32_t head = mid - from;
+    uint32_t tail = program->count - mid;
+    memcpy(tmp, &program->code[from], head * sizeof(NoiseInstr));
+    memmove(&program->code[from], &program->code[mid], tail * sizeof(NoiseInstr));
+    memcpy(&program->code[from + tail], tmp, head * sizeof(NoiseInstr));
+}
+
+static void parseExpr(Parser* p);
+
+static void parseNode(Parser* p) {
+    char name[32];
+    uint32_t len = 0;
+    while(isalpha((unsigned char)*p->cur) && len + 1 < sizeof(name))
+        name[len++] = *p->cur++;
+    name[len] = '\0';
+
+    const NoiseNode* node = 0;
+    for(uint32_t i = 0; i < ARR_LEN(nodes); i++) {
+        if(strcmp(nodes[i].name, name) == 0)
+            node = &nodes[i];
+    }
+    if(!node) {
+        parseError(p, "Unknown node");
+        return;
+    }
+
+    expect(p, '(');
+
+    uint32_t start = p->program->count;
+    uint32_t baseEnd = start;
+    uint32_t inputs = 0;
+    for(; inputs < node->inputs && p->ok; inputs++) {
+        if(inputs > 0)
+            expect(p, ',');
+        if(node->op == NOISE_OP_WARP_PUSH && inputs == 0) {
+            p->warpDepth++;
+            if(p->warpDepth > NOISE_MAX_WARP)
+                parseError(p, "Too many nested warps");
+            parseExpr(p);
+            p->warpDepth--;
+            baseEnd = p->program->count;
+        } else {
+            parseExpr(p);
+        }
+        if((node->op == NOISE_OP_ADD || node->op == NOISE_OP_MUL) && inputs > 0) {
+            emit(p, node->op, 0);
+            p->depth--;
+        }
+    }
+    if(node->op == NOISE_OP_ADD || node->op == NOISE_OP_MUL) {
+        while(p->ok && accept(p, ',')) {
+            parseExpr(p);
+            emit(p, node->op, 0);
+            p->depth--;
+        }
+    }
+
+    float params[NOISE_MAX_PARAMS];
+    memcpy(params, node->defaults, sizeof(params));
+    uint32_t count = 0;
+    while(p->ok && count < node->maxParams) {
+        if(inputs > 0 || count > 0) {
+            if(!accept(p, ','))
+                break;
+        } else if(!peekNumber(p)) {
+            break;
+        }
+        params[count++] = parseNumber(p);
+    }
+    if(count < node->minParams)
+        parseError(p, "Missing parameters");
+    expect(p, ')');
+    if(!p->ok)
+        return;
+
+    switch(node->op) {
+        case NOISE_OP_PERLIN:
+        case NOISE_OP_FBM:
+        case NOISE_OP_RIDGE:
+        case NOISE_OP_TURBULENCE:
+            if(node->op != NOISE_OP_PERLIN && params[0] < 0)
+                params[0] = p->defaultOctaves;
+            if(node->op != NOISE_OP_PERLIN && (params[0] < 1 || params[0] > 32))
+                parseError(p, "Octaves have to be in [1, 32]");
+            emit(p, node->op, params);
+            push(p, 1);
+            break;
+        case NOISE_OP_CELLS:
+            if(params[1] != NOISE_CELLS_F1 && params[1] != NOISE_CELLS_F2 && params[1] != NOISE_CELLS_F2_MINUS_F1)
+                parseError(p, "Cells mode has to be 0 (F1), 1 (F2) or 2 (F2-F1)");
+            emit(p, node->op, params);
+            push(p, 1);
+            break;
+        case NOISE_OP_CLAMP:
+        case NOISE_OP_REMAP:
+            if(node->op == NOISE_OP_REMAP && params[0] == params[1])
+                parseError(p, "Remap input range is empty");
+            emit(p, node->op, params);
+            break;
+        case NOISE_OP_WARP_PUSH:
+            // Written as warp(base, dx, dy) but the offsets have to be known
+            // before the base is sampled, so the base code is moved behind them
+            rotateCode(p->program, start, baseEnd);
+            emit(p, NOISE_OP_WARP_PUSH, params);
+            if(p->ok)
+                rotateCode(p->program, start + (p->program->count - 1 - baseEnd), p->program->count - 1);
+            emit(p, NOISE_OP_WARP_POP, 0);
+            p->depth -= 2;
+            break;
+        default:
+            break;
+    }
+}
+
+static void parseExpr(Parser* p) {
+    skipSpace(p);
+    if(!p->ok)
+        return;
+    if(peekNumber(p)) {
+        float params[NOISE_MAX_PARAMS] = { parseNumber(p) };
+        emit(p, NOISE_OP_CONST, params);
+        push(p, 1);
+    } else if(isalpha((unsigned char)*p->cur)) {
+        parseNode(p);
+    } else {
+        parseError(p, "Expected a node or a number");
+    }
+}
+
+bool noiseCompile(const char* src, int defaultOctaves, const NoiseBackend* backend, NoiseProgram* program) {
+    Parser p = {
+        .src = src,
+        .cur = src,
+        .program = program,
+        .defaultOctaves = defaultOctaves,
+        .ok = true
+    };
+    memset(program, 0, sizeof(NoiseProgram));
+    program->backend = backend;
+
+    parseExpr(&p);
+    skipSpace(&p);
+    if(p.ok && *p.cur != '\0')
+        parseError(&p, "Unexpected trailing input");
+
+    return p.ok;
+}
+
+float getPerlin2D(float x, float y, int octaves, int seed) {
+    float v = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+    float max = 0.0f;
+
+    for(int i = 0; i < octaves; i++) {
+        v += stb_perlin_noise3_seed(x * frequency, 0, y * frequency, 0, 0, 0, seed) * amplitude;
+        max += amplitude;
+        frequency *= 2.0f;
+        amplitude *= 0.5f;
+    }
+
+    return v/max;
+}
+
+#define HASH_PRIME_X ((int32_t)0x8da6b343)
+#define HASH_PRIME_Y ((int32_t)0xd8163841)
+#define HASH_MIX_A ((int32_t)0x27d4eb2d)
+#define HASH_MIX_B ((int32_t)0x165667b1)
+
+static inline I4 hashCorner(I4 corner, I4 seed) {
+    I4 h = i4Mul(i4Xor(corner, seed), i4Set1(HASH_MIX_A));
+    h = i4Xor(h, i4Shr(h, 16));
+    return i4Mul(h, i4Set1(HASH_MIX_B));
+}
+
+// Gradient (+-1, +-1), the signs come from the two top bits of the hash
+static inline F4 gradDot(I4 h, F4 x, F4 y) {
+    return f4Add(f4FlipSign(x, h), f4FlipSign(y, i4Shl(h, 1)));
+}
+
+static inline F4 fade(F4 t) {
+    F4 p = f4Add(f4Mul(t, f4Sub(f4Mul(t, f4Set1(6.0f)), f4Set1(15.0f))), f4Set1(10.0f));
+    return f4Mul(f4Mul(f4Mul(t, t), t), p);
+}
+
+static inline F4 lerp(F4 a, F4 b, F4 t) {
+    return f4Add(a, f4Mul(f4Sub(b, a), t));
+}
+
+/*   Perlin backend   */
+
+static void perlinNoise2(const float* x, const float* y, uint32_t n, int seed, float* out) {
+    for(uint32_t i = 0; i < n; i++)
+        out[i] = stb_perlin_noise3_seed(x[i], 0, y[i], 0, 0, 0, seed);
+}
+
+/*   Simplex backend   */
+
+#define SIMPLEX_F2 0.36602540378f
+#define SIMPLEX_G2 0.21132486540f
+// Brings the peaks of the sum of the three corner kernels to about +-1
+#define SIMPLEX_SCALE 92.0f
+// tan(22.5 deg), the gradients point at 22.5 + k * 45 degrees so none is axis aligned
+#define SIMPLEX_GRAD_MINOR 0.41421356f
+
+// Bit 31 & 30 of the hash pick the signs, bit 29 swaps the axes
+static inline F4 simplexGradDot(I4 h, F4 x, F4 y) {
+    F4 swap = f4MaskFromBit(h, 29);
+    F4 a = f4Select(x, y, swap);
+    F4 b = f4Select(y, x, swap);
+    return f4Add(f4FlipSign(a, h), f4FlipSign(f4Mul(b, f4Set1(SIMPLEX_GRAD_MINOR)), i4Shl(h, 1)));
+}
+
+static inline F4 simplexCorner(I4 h, F4 x, F4 y) {
+    F4 t = f4Sub(f4Sub(f4Set1(0.5f), f4Mul(x, x)), f4Mul(y, y));
+    t = f4Max(t, f4Set1(0.0f));
+    t = f4Mul(t, t);
+    return f4Mul(f4Mul(t, t), simplexGradDot(h, x, y));
+}
+
+static F4 simplexNoise4(F4 x, F4 y, I4 seed) {
+    F4 s = f4Mul(f4Add(x, y), f4Set1(SIMPLEX_F2));
+    I4 i = i4Floor(f4Add(x, s));
+    I4 j = i4Floor(f4Add(y, s));
+    F4 fi = f4FromI4(i);
+    F4 fj = f4FromI4(j);
+    F4 t = f4Mul(f4Add(fi, fj), f4Set1(SIMPLEX_G2));
+    F4 x0 = f4Sub(x, f4Sub(fi, t));
+    F4 y0 = f4Sub(y, f4Sub(fj, t));
+
+    // The middle corner is one step along x when the point is below the diagonal
+    F4 lower = f4Less(y0, x0);
+    F4 one = f4Set1(1.0f);
+    F4 i1 = f4Select(f4Set1(0.0f), one, lower);
+    F4 j1 = f4Sub(one, i1);
+    F4 x1 = f4Add(f4Sub(x0, i1), f4Set1(SIMPLEX_G2));
+    F4 y1 = f4Add(f4Sub(y0, j1), f4Set1(SIMPLEX_G2));
+    F4 x2 = f4Add(f4Sub(x0, one), f4Set1(2.0f * SIMPLEX_G2));
+    F4 y2 = f4Add(f4Sub(y0, one), f4Set1(2.0f * SIMPLEX_G2));
+
+    I4 hx0 = i4Mul(i, i4Set1(HASH_PRIME_X));
+    I4 hy0 = i4Mul(j, i4Set1(HASH_PRIME_Y));
+    I4 hx1 = i4Add(hx0, i4Set1(HASH_PRIME_X));
+    I4 hy1 = i4Add(hy0, i4Set1(HASH_PRIME_Y));
+    I4 lowerMask = i4FromF4Bits(lower);
+    I4 mx = i4Add(hx0, i4And(lowerMask, i4Set1(HASH_PRIME_X)));
+    I4 my = i4Add(hy0, i4AndNot(lowerMask, i4Set1(HASH_PRIME_Y)));
+
+    F4 n = simplexCorner(hashCorner(i4Xor(hx0, hy0), seed), x0, y0);
+    n = f4Add(n, simplexCorner(hashCorner(i4Xor(mx, my), seed), x1, y1));
+    n = f4Add(n, simplexCorner(hashCorner(i4Xor(hx1, hy1), seed), x2, y2));
+    return f4Mul(n, f4Set1(SIMPLEX_SCALE));
+}
+
+static void simplexNoise2(const float* x, const float* y, uint32_t n, int seed, float* out) {
+    I4 s = i4Set1((int32_t)((uint32_t)seed * 0x9e3779b9u));
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        f4Store(out + i, simplexNoise4(f4Load(x + i), f4Load(y + i), s));
+    if(i < n) {
+        float bx[4] = { 0 }, by[4] = { 0 }, bo[4];
+        for(uint32_t l = 0; i + l < n; l++) {
+            bx[l] = x[i + l];
+            by[l] = y[i + l];
+        }
+        f4Store(bo, simplexNoise4(f4Load(bx), f4Load(by), s));
+        for(uint32_t l = 0; i + l < n; l++)
+            out[i + l] = bo[l];
+    }
+}
+
+/*   Worley noise   */
+
+// Random point inside the cell, 23 hash bits per axis become a float in [0, 1)
+static inline void cellPoint(I4 h, F4* x, F4* y) {
+    *x = f4Sub(f4FromI4Bits(i4Or(i4Shr(h, 9), i4Set1(0x3f800000))), f4Set1(1.0f));
+    h = i4Mul(h, i4Set1(HASH_MIX_A));
+    *y = f4Sub(f4FromI4Bits(i4Or(i4Shr(h, 9), i4Set1(0x3f800000))), f4Set1(1.0f));
+}
+
+static void cellsNoise4(F4 x, F4 y, I4 seed, float jitter, F4* f1, F4* f2) {
+    I4 ix = i4Floor(x);
+    I4 iy = i4Floor(y);
+    F4 fx = f4Sub(x, f4FromI4(ix));
+    F4 fy = f4Sub(y, f4FromI4(iy));
+    I4 hx = i4Mul(ix, i4Set1(HASH_PRIME_X));
+    I4 hy = i4Mul(iy, i4Set1(HASH_PRIME_Y));
+    F4 half = f4Set1(0.5f);
+    F4 j = f4Set1(jitter);
+
+    // Squared distances, the square roots are only taken for the two results
+    F4 d1 = f4Set1(FLT_MAX);
+    F4 d2 = f4Set1(FLT_MAX);
+    for(int32_t oy = -1; oy <= 1; oy++) {
+        I4 cy = i4Add(hy, i4Set1(oy * HASH_PRIME_Y));
+        F4 ry = f4Sub(f4Set1((float)oy + 0.5f), fy);
+        for(int32_t ox = -1; ox <= 1; ox++) {
+            I4 h = hashCorner(i4Xor(i4Add(hx, i4Set1(ox * HASH_PRIME_X)), cy), seed);
+            F4 px, py;
+            cellPoint(h, &px, &py);
+            F4 dx = f4Add(f4Sub(f4Set1((float)ox + 0.5f), fx), f4Mul(f4Sub(px, half), j));
+            F4 dy = f4Add(ry, f4Mul(f4Sub(py, half), j));
+            F4 d = f4Add(f4Mul(dx, dx), f4Mul(dy, dy));
+            d2 = f4Min(d2, f4Max(d1, d));
+            d1 = f4Min(d1, d);
+        }
+    }
+
+    *f1 = f4Sqrt(d1);
+    *f2 = f4Sqrt(d2);
+}
+
+void noiseCells2(const float* x, const float* y, uint32_t n, int seed, NoiseCellsMode mode, float jitter, float* out) {
+    I4 s = i4Set1((int32_t)((uint32_t)seed * 0x85ebca6bu + 3u));
+    for(uint32_t i = 0; i < n; i += 4) {
+        float bx[4], by[4], bo[4];
+        uint32_t lanes = n - i < 4 ? n - i : 4;
+        for(uint32_t l = 0; l < 4; l++) {
+            bx[l] = x[i + (l < lanes ? l : lanes - 1)];
+            by[l] = y[i + (l < lanes ? l : lanes - 1)];
+        }
+
+        F4 f1, f2;
+        cellsNoise4(f4Load(bx), f4Load(by), s, jitter, &f1, &f2);
+        switch(mode) {
+            case NOISE_CELLS_F1: f4Store(bo, f1); break;
+            case NOISE_CELLS_F2: f4Store(bo, f2); break;
+            case NOISE_CELLS_F2_MINUS_F1: f4Store(bo, f4Sub(f2, f1)); break;
+        }
+
+        for(uint32_t l = 0; l < lanes; l++)
+            out[i + l] = bo[l];
+    }
+}
+
+const NoiseBackend noiseBackends[] = {
+    { "perlin", perlinNoise2 },
+    { "simplex", simplexNoise2 },
+};
+const uint32_t noiseBackendCount = ARR_LEN(noiseBackends);
+
+const NoiseBackend* noiseFindBackend(const char* name) {
+    for(uint32_t i = 0; i < noiseBackendCount; i++) {
+        if(strcmp(noiseBackends[i].name, name) == 0)
+            return &noiseBackends[i];
+    }
+    return 0;
+}
+
+// fbm, ridge & turbulence over the backend, a whole octave of the tile at a time
+static void fractal(const NoiseBackend* backend, const NoiseInstr* instr, int octaveLimit, int seed, const float* x, const float* y, uint32_t n, float* out) {
+    const float* p = instr->params;
+    float xs[NOISE_TILE_SIZE], ys[NOISE_TILE_SIZE], octave[NOISE_TILE_SIZE], prev[NOISE_TILE_SIZE];
+    int octaves = (int)p[0];
+    if(octaveLimit > 0 && octaves > octaveLimit)
+        octaves = octaveLimit;
+    float lacunarity = p[1];
+    float gain = p[2];
+    float base = instr->op == NOISE_OP_RIDGE ? p[4] : p[3];
+    float frequency = 1.0f;
+    float amplitude = instr->op == NOISE_OP_RIDGE ? 0.5f : 1.0f;
+    float max = 0.0f;
+
+    for(uint32_t i = 0; i < n; i++) {
+        out[i] = 0.0f;
+        prev[i] = 1.0f;
+    }
+
+    for(int o = 0; o < octaves; o++) {
+        for(uint32_t i = 0; i < n; i++) {
+            xs[i] = (x[i] * base) * frequency;
+            ys[i] = (y[i] * base) * frequency;
+        }
+
+        switch(instr->op) {
+            case NOISE_OP_FBM:
+                backend->noise2(xs, ys, n, seed, octave);
+                for(uint32_t i = 0; i < n; i++)
+                    out[i] += octave[i] * amplitude;
+                break;
+            case NOISE_OP_RIDGE:
+                backend->noise2(xs, ys, n, seed + o, octave);
+                for(uint32_t i = 0; i < n; i++) {
+                    float r = p[3] - fabsf(octave[i]);
+                    r = r * r;
+                    out[i] += r * amplitude * prev[i];
+                    prev[i] = r;
+                }
+                break;
+            case NOISE_OP_TURBULENCE:
+                backend->noise2(xs, ys, n, seed + o, octave);
+                for(uint32_t i = 0; i < n; i++)
+                    out[i] += fabsf(octave[i] * amplitude);
+                break;
+            default:
+                break;
+        }
+
+        max += amplitude;
+        frequency *= lacunarity;
+        amplitude *= gain;
+    }
+
+    if(instr->op == NOISE_OP_FBM) {
+        for(uint32_t i = 0; i < n; i++)
+            out[i] /= max;
+    }
+}
+
+void noiseEvalTile(const NoiseProgram* program, int seed, const float* x, const float* y, uint32_t n, float* out) {
+    float stack[NOISE_MAX_STACK][NOISE_TILE_SIZE];
+    float coords[NOISE_MAX_WARP][2][NOISE_TILE_SIZE];
+    float scratch[NOISE_TILE_SIZE];
+    const float* cx = x;
+    const float* cy = y;
+    uint32_t sp = 0;
+    uint32_t wp = 0;
+
+    for(uint32_t pc = 0; pc < program->count; pc++) {
+        const NoiseInstr* instr = &program->code[pc];
+        const float* p = instr->params;
+        float* top = stack[sp];
+
+        switch(instr->op) {
+            case NOISE_OP_CONST:
+                for(uint32_t i = 0; i < n; i++)
+                    top[i] = p[0];
+                sp++;
+                break;
+            case NOISE_OP_PERLIN:
+                for(uint32_t i = 0; i < n; i++) {
+                    top[i] = cx[i] * p[0];
+                    scratch[i] = cy[i] * p[0];
+                }
+                program->backend->noise2(top, scratch, n, seed, top);
+                sp++;
+                break;
+            case NOISE_OP_FBM:
+            case NOISE_OP_RIDGE:
+            case NOISE_OP_TURBULENCE:
+                fractal(program->backend, instr, program->octaveLimit, seed, cx, cy, n, top);
+                sp++;
+                break;
+            case NOISE_OP_CELLS:
+                for(uint32_t i = 0; i < n; i++) {
+                    top[i] = cx[i] * p[0];
+                    scratch[i] = cy[i] * p[0];
+                }
+                noiseCells2(top, scratch, n, seed, (NoiseCellsMode)p[1], p[2], top);
+                sp++;
+                break;
+            case NOISE_OP_ADD: {
+                float* a = stack[sp - 2];
+                float* b = stack[sp - 1];
+                for(uint32_t i = 0; i < n; i++)
+                    a[i] += b[i];
+                sp--;
+            } break;
+            case NOISE_OP_MUL: {
+                float* a = stack[sp - 2];
+                float* b = stack[sp - 1];
+                for(uint32_t i = 0; i < n; i++)
+                    a[i] *= b[i];
+                sp--;
+            } break;
+            case NOISE_OP_CLAMP: {
+                float* a = stack[sp - 1];
+                for(uint32_t i = 0; i < n; i++)
+                    a[i] = a[i] < p[0] ? p[0] : (a[i] > p[1] ? p[1] : a[i]);
+            } break;
+            case NOISE_OP_REMAP: {
+                float* a = stack[sp - 1];
+                float scale = (p[3] - p[2]) / (p[1] - p[0]);
+                for(uint32_t i = 0; i < n; i++)
+                    a[i] = p[2] + (a[i] - p[0]) * scale;
+            } break;
+            case NOISE_OP_WARP_PUSH: {
+                const float* dx = stack[sp - 2];
+                const float* dy = stack[sp - 1];
+                float* wx = coords[wp][0];
+                float* wy = coords[wp][1];
+                for(uint32_t i = 0; i < n; i++) {
+                    wx[i] = cx[i] + dx[i] * p[0];
+                    wy[i] = cy[i] + dy[i] * p[0];
+                }
+                cx = wx;
+                cy = wy;
+                wp++;
+                sp -= 2;
+            } break;
+            case NOISE_OP_WARP_POP:
+                wp--;
+                cx = wp == 0 ? x : coords[wp - 1][0];
+                cy = wp == 0 ? y : coords[wp - 1][1];
+                break;
+        }
+    }
+
+    memcpy(out, stack[0], n * sizeof(float));
+}
+
+// Two independent gradient noise fields at the same points, only the final
+// corner hashes and the blends depend on the field
+static void gradientNoisePair(F4 x, F4 y, I4 seedA, I4 seedB, F4* a, F4* b) {
+    I4 ix = i4Floor(x);
+    I4 iy = i4Floor(y);
+    F4 fx0 = f4Sub(x, f4FromI4(ix));
+    F4 fy0 = f4Sub(y, f4FromI4(iy));
+    F4 fx1 = f4Sub(fx0, f4Set1(1.0f));
+    F4 fy1 = f4Sub(fy0, f4Set1(1.0f));
+    F4 u = fade(fx0);
+    F4 v = fade(fy0);
+
+    I4 hx0 = i4Mul(ix, i4Set1(HASH_PRIME_X));
+    I4 hy0 = i4Mul(iy, i4Set1(HASH_PRIME_Y));
+    I4 hx1 = i4Add(hx0, i4Set1(HASH_PRIME_X));
+    I4 hy1 = i4Add(hy0, i4Set1(HASH_PRIME_Y));
+    I4 c00 = i4Xor(hx0, hy0);
+    I4 c10 = i4Xor(hx1, hy0);
+    I4 c01 = i4Xor(hx0, hy1);
+    I4 c11 = i4Xor(hx1, hy1);
+
+    F4 n0 = lerp(gradDot(hashCorner(c00, seedA), fx0, fy0), gradDot(hashCorner(c10, seedA), fx1, fy0), u);
+    F4 n1 = lerp(gradDot(hashCorner(c01, seedA), fx0, fy1), gradDot(hashCorner(c11, seedA), fx1, fy1), u);
+    *a = lerp(n0, n1, v);
+
+    n0 = lerp(gradDot(hashCorner(c00, seedB), fx0, fy0), gradDot(hashCorner(c10, seedB), fx1, fy0), u);
+    n1 = lerp(gradDot(hashCorner(c01, seedB), fx0, fy1), gradDot(hashCorner(c11, seedB), fx1, fy1), u);
+    *b = lerp(n0, n1, v);
+}
+
+void noiseWarpTile(const NoiseWarp* warp, int seed, float* x, float* y, uint32_t n) {
+    if(warp->strength == 0.0f || warp->octaves <= 0)
+        return;
+
+    float max = 0.0f;
+    float amplitude = 1.0f;
+    for(int o = 0; o < warp->octaves; o++) {
+        max += amplitude;
+        amplitude *= 0.5f;
+    }
+    F4 strength = f4Set1(warp->strength / max);
+    int32_t seedA = (int32_t)((uint32_t)seed * 0x9e3779b9u + 1u);
+    int32_t seedB = (int32_t)((uint32_t)seed * 0x9e3779b9u + 2u);
+
+    for(uint32_t i = 0; i < n; i += 4) {
+        float bx[4], by[4];
+        uint32_t lanes = n - i < 4 ? n - i : 4;
+        for(uint32_t l = 0; l < 4; l++) {
+            bx[l] = x[i + (l < lanes ? l : lanes - 1)];
+            by[l] = y[i + (l < lanes ? l : lanes - 1)];
+        }
+        F4 px = f4Load(bx);
+        F4 py = f4Load(by);
+
+        F4 qx = f4Set1(0.0f);
+        F4 qy = f4Set1(0.0f);
+        float frequency = 1.0f;
+        amplitude = 1.0f;
+        for(int o = 0; o < warp->octaves; o++) {
+            F4 a, b;
+            F4 f = f4Set1(frequency);
+            I4 octave = i4Set1(o * HASH_PRIME_Y);
+            gradientNoisePair(f4Mul(px, f), f4Mul(py, f), i4Add(i4Set1(seedA), octave), i4Add(i4Set1(seedB), octave), &a, &b);
+            qx = f4Add(qx, f4Mul(a, f4Set1(amplitude)));
+            qy = f4Add(qy, f4Mul(b, f4Set1(amplitude)));
+            frequency *= 2.0f;
+            amplitude *= 0.5f;
+        }
+
+        f4Store(bx, f4Add(px, f4Mul(qx, strength)));
+        f4Store(by, f4Add(py, f4Mul(qy, strength)));
+        for(uint32_t l = 0; l < lanes; l++) {
+            x[i + l] = bx[l];
+            y[i + l] = by[l];
+        }
+    }
+}
+
+/*   Fixed point fbm   */
+
+// Smootherstep of a Q15 fraction as a Q14 blend weight, 6t^5 - 15t^4 + 10t^3
+// evaluated as t^3 * (10 + t * (6t - 15)) with the inner factor in Q11
+static inline I4 fixedFade(I4 t) {
+    I4 t2 = i4Sar(i4MulShort(t, t), 15);
+    I4 t3 = i4Sar(i4MulShort(t2, t), 15);
+    I4 sixT = i4Sar(i4Add(i4Shl(t, 2), i4Shl(t, 1)), 4);
+    I4 inner = i4Add(i4Set1(10 << 11), i4Sar(i4MulShort(i4Sub(sixT, i4Set1(15 << 11)), t), 15));
+    return i4Sar(i4Sar(i4MulShort(inner, t3), 11), 1);
+}
+
+// (+-x +-y) / 2 with the signs taken from the two top hash bits.
+// Only the (-1, -1) corner at a zero fraction can reach 32768, and its weight is 0 then.
+static inline I4 fixedGradDot(I4 h, I4 x, I4 y) {
+    I4 sx = i4Sar(h, 31);
+    I4 sy = i4Sar(i4Shl(h, 1), 31);
+    return i4Sar(i4Add(i4Sub(i4Xor(x, sx), sx), i4Sub(i4Xor(y, sy), sy)), 1);
+}
+
+// a + (b - a) * w with a Q14 weight, written as a sum so every product fits madd
+static inline I4 fixedLerp(I4 a, I4 b, I4 w) {
+    return i4Sar(i4Add(i4MulShort(a, i4Sub(i4Set1(1 << 14), w)), i4MulShort(b, w)), 14);
+}
+
+static I4 fixedNoise4(I4 x, I4 y, I4 seed) {
+    I4 ix = i4Shr(x, 16);
+    I4 iy = i4Shr(y, 16);
+    I4 fx0 = i4And(i4Shr(x, 1), i4Set1(0x7fff));
+    I4 fy0 = i4And(i4Shr(y, 1), i4Set1(0x7fff));
+    I4 fx1 = i4Sub(fx0, i4Set1(0x8000));
+    I4 fy1 = i4Sub(fy0, i4Set1(0x8000));
+    I4 u = fixedFade(fx0);
+    I4 v = fixedFade(fy0);
+
+    I4 hx0 = i4Mul(ix, i4Set1(HASH_PRIME_X));
+    I4 hy0 = i4Mul(iy, i4Set1(HASH_PRIME_Y));
+    I4 hx1 = i4Add(hx0, i4Set1(HASH_PRIME_X));
+    I4 hy1 = i4Add(hy0, i4Set1(HASH_PRIME_Y));
+
+    I4 n0 = fixedLerp(fixedGradDot(hashCorner(i4Xor(hx0, hy0), seed), fx0, fy0), fixedGradDot(hashCorner(i4Xor(hx1, hy0), seed), fx1, fy0), u);
+    I4 n1 = fixedLerp(fixedGradDot(hashCorner(i4Xor(hx0, hy1), seed), fx0, fy1), fixedGradDot(hashCorner(i4Xor(hx1, hy1), seed), fx1, fy1), u);
+    return fixedLerp(n0, n1, v);
+}
+
+void noiseFixedTile(int octaves, int seed, const int32_t* x, const int32_t* y, uint32_t n, uint8_t* out) {
+    // Largest possible magnitude of the sum, a noise value of 1.0 is 1 << 14
+    int64_t max = 0;
+    for(int o = 0; o < octaves; o++)
+        max += (1 << 14) >> o;
+    uint32_t s = (uint32_t)seed * 0x9e3779b9u;
+
+    for(uint32_t i = 0; i < n; i += 4) {
+        int32_t bx[4], by[4], sum[4];
+        uint32_t lanes = n - i < 4 ? n - i : 4;
+        for(uint32_t l = 0; l < 4; l++) {
+            bx[l] = x[i + (l < lanes ? l : lanes - 1)];
+            by[l] = y[i + (l < lanes ? l : lanes - 1)];
+        }
+        I4 px = i4Mul(i4Load(bx), i4Set1(NOISE_FIXED_SCALE));
+        I4 py = i4Mul(i4Load(by), i4Set1(NOISE_FIXED_SCALE));
+
+        I4 acc = i4Set1(0);
+        for(int o = 0; o < octaves; o++) {
+            I4 octaveSeed = i4Set1((int32_t)(s + (uint32_t)o * (uint32_t)HASH_PRIME_Y));
+            acc = i4Add(acc, i4Sar(fixedNoise4(i4Shl(px, o), i4Shl(py, o), octaveSeed), o));
+        }
+
+        i4Store(sum, acc);
+        for(uint32_t l = 0; l < lanes; l++) {
+            int64_t v = ((sum[l] + max) * 255) / (2 * max);
+            out[i + l] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Samples are evaluated in square tiles, every intermediate value of the
+// graph lives in a tile sized register so nothing full size is ever allocated
+#define NOISE_TILE_DIM 16
+#define NOISE_TILE_SIZE (NOISE_TILE_DIM * NOISE_TILE_DIM)
+#define NOISE_MAX_STACK 16
+#define NOISE_MAX_WARP 4
+#define NOISE_MAX_INSTRUCTIONS 128
+#define NOISE_MAX_PARAMS 5
+
+typedef enum {
+    NOISE_OP_CONST,
+    NOISE_OP_PERLIN,
+    NOISE_OP_FBM,
+    NOISE_OP_RIDGE,
+    NOISE_OP_TURBULENCE,
+    NOISE_OP_CELLS,
+    NOISE_OP_ADD,
+    NOISE_OP_MUL,
+    NOISE_OP_CLAMP,
+    NOISE_OP_REMAP,
+    NOISE_OP_WARP_PUSH,
+    NOISE_OP_WARP_POP
+} NoiseOp;
+
+typedef struct {
+    NoiseOp op;
+    float params[NOISE_MAX_PARAMS];
+} NoiseInstr;
+
+// Domain warp applied to the sample coordinates before the graph runs
+typedef struct {
+    float strength;
+    int octaves;
+} NoiseWarp;
+
+typedef enum {
+    NOISE_CELLS_F1,
+    NOISE_CELLS_F2,
+    NOISE_CELLS_F2_MINUS_F1
+} NoiseCellsMode;
+
+// Source of the gradient noise that the graph nodes are built from
+typedef struct {
+    const char* name;
+    // Writes 'n' samples in about [-1, 1], 'out' may alias 'x' or 'y'
+    void (*noise2)(const float* x, const float* y, uint32_t n, int seed, float* out);
+} NoiseBackend;
+
+extern const NoiseBackend noiseBackends[];
+extern const uint32_t noiseBackendCount;
+
+// Flat postfix form of a noise graph
+typedef struct {
+    NoiseInstr code[NOISE_MAX_INSTRUCTIONS];
+    uint32_t count;
+    const NoiseBackend* backend;
+    // Caps the octaves of every fractal node, 0 means no cap
+    int octaveLimit;
+    // Replaces the graph with the integer fbm below
+    bool fixedPoint;
+    int fixedOctaves;
+} NoiseProgram;
+
+const NoiseBackend* noiseFindBackend(const char* name);
+// Worley noise, distance to the nearest (F1) or second nearest (F2) feature
+// point with one jittered point per lattice cell
+void noiseCells2(const float* x, const float* y, uint32_t n, int seed, NoiseCellsMode mode, float jitter, float* out);
+
+// Compiles a graph like "add(fbm(8), mul(ridge(4), 0.3))" into a program.
+// Octave parameters that are left out default to 'defaultOctaves'.
+bool noiseCompile(const char* src, int defaultOctaves, const NoiseBackend* backend, NoiseProgram* program);
+// Evaluates 'n' (<= NOISE_TILE_SIZE) samples at the coordinates (x[i], y[i])
+void noiseEvalTile(const NoiseProgram* program, int seed, const float* x, const float* y, uint32_t n, float* out);
+// Offsets (x[i], y[i]) by two fbm fields, both are evaluated in the same
+// SIMD loop and share the lattice cell, fraction and fade computations
+void noiseWarpTile(const NoiseWarp* warp, int seed, float* x, float* y, uint32_t n);
+
+// Grid to noise space scale of the fixed point path in 16.16, about 0.025
+#define NOISE_FIXED_SCALE 1638
+
+// Integer only fbm of 'octaves' octaves at the integer grid points (x[i], y[i]).
+// Writes heights in [0, 255], the result is the same bits on every compiler & CPU.
+void noiseFixedTile(int octaves, int seed, const int32_t* x, const int32_t* y, uint32_t n, uint8_t* out);
+
+// Reference fbm on stb_perlin, same as fbm(octaves) on the perlin backend
+float getPerlin2D(float x, float y, int octaves, int seed);
@@ -0,0 +1,117 @@
+#include "normalmap.h"
+
+#include <glad/glad.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jobs.h"
+#include "simd.h"
+
+typedef struct {
+    NormalMap* map;
+    const uint32_t* heights;
+    uint32_t x0, z0, x1, z1;
+} NormalJob;
+
+// Rounds to the closest of -127..127 as two's complement in the low byte
+static inline uint16_t packSnorm(float v) {
+    return (uint16_t)((int32_t)floorf(v * 127.0f + 0.5f) & 0xff);
+}
+
+// Neighbours past an edge are the texel itself, as in the vertex buffers' baked normals
+static uint16_t texelNormal(const NormalMap* map, const uint32_t* heights, uint32_t x, uint32_t z) {
+    uint32_t xl = x > 0 ? x - 1 : x, xr = x + 1 < map->width ? x + 1 : x;
+    uint32_t zd = z > 0 ? z - 1 : z, zu = z + 1 < map->height ? z + 1 : z;
+    float scale = map->unitHeight / map->spacing;
+    float nx = ((float)(heights[(size_t)z * map->width + xl] & 0xff) - (float)(heights[(size_t)z * map->width + xr] & 0xff)) * scale;
+    float nz = ((float)(heights[(size_t)zd * map->width + x] & 0xff) - (float)(heights[(size_t)zu * map->width + x] & 0xff)) * scale;
+    float sum = fabsf(nx) + 2.0f + fabsf(nz);
+    return packSnorm(nx / sum) | packSnorm(nz / sum) << 8;
+}
+
+static void updateRows(void* user, uint32_t begin, uint32_t end) {
+    const NormalJob* job = user;
+    const NormalMap* map = job->map;
+    F4 scale = f4Set1(map->unitHeight / map->spacing);
+    F4 two = f4Set1(2.0f), snorm = f4Set1(127.0f), half = f4Set1(0.5f);
+    I4 byte = i4Set1(0xff);
+
+    for(uint32_t z = job->z0 + begin; z < job->z0 + end; z++) {
+        const int32_t* row = (const int32_t*)job->heights + (size_t)z * map->width;
+        const int32_t* down = z > 0 ? row - map->width : row;
+        const int32_t* up = z + 1 < map->height ? row + map->width : row;
+        uint16_t* out = map->texels + (size_t)z * map->width;
+
+        uint32_t x = job->x0;
+        if(x == 0) {
+            out[0] = texelNormal(map, job->heights, 0, z);
+            x++;
+        }
+        // Texels with both neighbours in the row, the one past the last x too
+        for(; x + 4 <= job->x1 + 1 && x + 4 < map->width; x += 4) {
+            F4 l = f4FromI4(i4And(i4Load(row + x - 1), byte));
+            F4 r = f4FromI4(i4And(i4Load(row + x + 1), byte));
+            F4 d = f4FromI4(i4And(i4Load(down + x), byte));
+            F4 u = f4FromI4(i4And(i4Load(up + x), byte));
+            F4 nx = f4Mul(f4Sub(l, r), scale);
+            F4 nz = f4Mul(f4Sub(d, u), scale);
+            F4 sum = f4Add(f4Add(f4Abs(nx), two), f4Abs(nz));
+            I4 px = i4Floor(f4Add(f4Mul(f4Div(nx, sum), snorm), half));
+            I4 pz = i4Floor(f4Add(f4Mul(f4Div(nz, sum), snorm), half));
+            int32_t packed[4];
+            i4Store(packed, i4Or(i4And(px, byte), i4Shl(i4And(pz, byte), 8)));
+            for(uint32_t i = 0; i < 4; i++)
+                out[x + i] = (uint16_t)packed[i];
+        }
+        for(; x <= job->x1; x++)
+            out[x] = texelNormal(map, job->heights, x, z);
+    }
+}
+
+bool normalMapInit(NormalMap* map, uint32_t width, uint32_t height, float spacing, float unitHeight) {
+    memset(map, 0, sizeof(NormalMap));
+    map->width = width;
+    map->height = height;
+    map->spacing = spacing;
+    map->unitHeight = unitHeight;
+    map->texels = malloc((size_t)width * height * sizeof(uint16_t));
+    return map->texels != 0;
+}
+
+void normalMapDestroy(NormalMap* map) {
+    free(map->texels);
+    memset(map, 0, sizeof(NormalMap));
+}
+
+void normalMapUpdate(NormalMap* map, const uint32_t* heights, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1) {
+    if(!map->texels || x0 > x1 || z0 > z1 || x0 >= map->width || z0 >= map->height)
+        return;
+    NormalJob job = {
+        .map = map,
+        .heights = heights,
+        .x0 = x0,
+        .z0 = z0,
+        .x1 = x1 < map->width ? x1 : map->width - 1,
+        .z1 = z1 < map->height ? z1 : map->height - 1
+    };
+    jobsParallelFor(job.z1 - z0 + 1, 16384 / (job.x1 - x0 + 1) + 1, updateRows, &job);
+}
+
+void normalMapUpload(const NormalMap* map, bool full, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1) {
+    // Rows of 2 byte texels aren't 4 byte aligned for odd widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if(full) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8_SNORM, map->width, map->height, 0, GL_RG, GL_BYTE, map->texels);
+    } else if(x0 <= x1 && z0 <= z1) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, map->width);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, x0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, z0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, x1 - x0 + 1, z1 - z0 + 1, GL_RG, GL_BYTE, map->texels);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per texel normals of a heightmap from central differences, like default.vert computes
+// them per vertex, packed onto the upper half of an octahedron as two snorm bytes (x, z).
+// 'y' is 1 - |x| - |z|. Built 4 texels at a time with SSE2 on every thread.
+typedef struct {
+    uint32_t width, height;
+    // Grid units between texels & world units per heightmap unit
+    float spacing, unitHeight;
+    // RG8 snorm texels, x in the low byte
+    uint16_t* texels;
+} NormalMap;
+
+bool normalMapInit(NormalMap* map, uint32_t width, uint32_t height, float spacing, float unitHeight);
+void normalMapDestroy(NormalMap* map);
+// Recomputes the texels [x0, x1] x [z0, z1] from 'heights' (RGBA8 with the height in red)
+void normalMapUpdate(NormalMap* map, const uint32_t* heights, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+// Uploads the texels [x0, x1] x [z0, z1] to the bound texture, or all of them as a new image when 'full'
+void normalMapUpload(const NormalMap* map, bool full, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
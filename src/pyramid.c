@@ -0,0 +1,200 @@
+#include "pyramid.h"
+
+#include <glad/glad.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "jobs.h"
+#include "simd.h"
+
+// Red, green & blue of a texel
+#define PYRAMID_AVG 0x000000ffu
+#define PYRAMID_MIN 0x0000ff00u
+#define PYRAMID_MAX 0xffff0000u
+
+typedef struct {
+    const uint32_t* src;
+    uint32_t* dst;
+    uint32_t width, height;
+    uint32_t dstWidth, dstHeight;
+} ReduceJob;
+
+static inline uint32_t minByte(uint32_t a, uint32_t b) { return a < b ? a : b; }
+static inline uint32_t maxByte(uint32_t a, uint32_t b) { return a > b ? a : b; }
+
+// Averages red, keeps the lower green & the higher blue, alpha stays 0xff
+static inline uint32_t combine(uint32_t a, uint32_t b) {
+    uint32_t avg = ((a & 0xff) + (b & 0xff) + 1) >> 1;
+    uint32_t lo = minByte((a >> 8) & 0xff, (b >> 8) & 0xff);
+    uint32_t hi = maxByte((a >> 16) & 0xff, (b >> 16) & 0xff);
+    return 0xff000000u | hi << 16 | lo << 8 | avg;
+}
+
+// Like combine() but leaves the average of 'a' alone, for the leftover texels of odd sizes
+static inline uint32_t widen(uint32_t a, uint32_t b) {
+    uint32_t lo = minByte((a >> 8) & 0xff, (b >> 8) & 0xff);
+    uint32_t hi = maxByte((a >> 16) & 0xff, (b >> 16) & 0xff);
+    return 0xff000000u | hi << 16 | lo << 8 | (a & 0xff);
+}
+
+static inline I4 combine4(I4 a, I4 b) {
+    I4 avg = i4And(i4AvgU8(a, b), i4Set1((int32_t)PYRAMID_AVG));
+    I4 lo = i4And(i4MinU8(a, b), i4Set1((int32_t)PYRAMID_MIN));
+    I4 hi = i4And(i4MaxU8(a, b), i4Set1((int32_t)PYRAMID_MAX));
+    return i4Or(avg, i4Or(lo, hi));
+}
+
+// Texel (x, y) of the level above job->src. The last row & column of odd sizes also fold
+// the leftover texels into their minimum & maximum.
+static uint32_t reduceTexel(const ReduceJob* job, uint32_t x, uint32_t y) {
+    uint32_t w = job->width;
+    const uint32_t* r0 = job->src + (size_t)(2 * y) * w;
+    const uint32_t* r1 = 2 * y + 1 < job->height ? r0 + w : r0;
+    uint32_t x1 = 2 * x + 1 < w ? 2 * x + 1 : 2 * x;
+    uint32_t out = combine(combine(r0[2 * x], r1[2 * x]), combine(r0[x1], r1[x1]));
+
+    bool lastColumn = x == job->dstWidth - 1 && (w & 1) && w > 1;
+    if(lastColumn)
+        out = widen(out, combine(r0[w - 1], r1[w - 1]));
+    if(y == job->dstHeight - 1 && (job->height & 1) && job->height > 1) {
+        const uint32_t* r2 = job->src + (size_t)(job->height - 1) * w;
+        out = widen(out, combine(r2[2 * x], r2[x1]));
+        if(lastColumn)
+            out = widen(out, r2[w - 1]);
+    }
+    return out;
+}
+
+static void reduceRows(void* user, uint32_t begin, uint32_t end) {
+    const ReduceJob* job = user;
+    uint32_t w = job->width;
+    bool oddColumn = (w & 1) && w > 1;
+    bool oddRow = (job->height & 1) && job->height > 1;
+
+    for(uint32_t y = begin; y < end; y++) {
+        uint32_t* out = job->dst + (size_t)y * job->dstWidth;
+        uint32_t x = 0;
+
+        // 4 output texels from 8 texels of both rows, the last row & column of odd sizes
+        // are left to reduceTexel()
+        if(!oddRow || y < job->dstHeight - 1) {
+            const uint32_t* r0 = job->src + (size_t)(2 * y) * w;
+            const uint32_t* r1 = 2 * y + 1 < job->height ? r0 + w : r0;
+            for(; 2 * x + 8 <= w && (!oddColumn || x + 4 < job->dstWidth); x += 4) {
+                I4 a = combine4(i4Load((const int32_t*)r0 + 2 * x), i4Load((const int32_t*)r1 + 2 * x));
+                I4 b = combine4(i4Load((const int32_t*)r0 + 2 * x + 4), i4Load((const int32_t*)r1 + 2 * x + 4));
+                i4Store((int32_t*)out + x, combine4(i4Evens(a, b), i4Odds(a, b)));
+            }
+        }
+        for(; x < job->dstWidth; x++)
+            out[x] = reduceTexel(job, x, y);
+    }
+}
+
+// Shrinks a rectangle of texels of level - 1 to the texels of 'level' covering it
+static void parentRect(const Pyramid* pyramid, uint32_t level, uint32_t rect[4]) {
+    uint32_t w = pyramid->widths[level], h = pyramid->heights[level];
+    rect[0] = rect[0] / 2 < w ? rect[0] / 2 : w - 1;
+    rect[1] = rect[1] / 2 < h ? rect[1] / 2 : h - 1;
+    rect[2] = rect[2] / 2 < w ? rect[2] / 2 : w - 1;
+    rect[3] = rect[3] / 2 < h ? rect[3] / 2 : h - 1;
+}
+
+void pyramidInit(Pyramid* pyramid, uint32_t width, uint32_t height) {
+    memset(pyramid, 0, sizeof(Pyramid));
+    size_t offset = 0;
+    while(true) {
+        uint32_t level = pyramid->levelCount++;
+        pyramid->widths[level] = width;
+        pyramid->heights[level] = height;
+        pyramid->offsets[level] = offset;
+        offset += (size_t)width * height;
+        if((width == 1 && height == 1) || pyramid->levelCount == PYRAMID_MAX_LEVELS)
+            break;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    pyramid->texelCount = offset;
+}
+
+void pyramidBuild(const Pyramid* pyramid, uint32_t* texels) {
+    for(uint32_t level = 1; level < pyramid->levelCount; level++) {
+        ReduceJob job = {
+            .src = texels + pyramid->offsets[level - 1],
+            .dst = texels + pyramid->offsets[level],
+            .width = pyramid->widths[level - 1],
+            .height = pyramid->heights[level - 1],
+            .dstWidth = pyramid->widths[level],
+            .dstHeight = pyramid->heights[level]
+        };
+        // Levels are small past the first few, only split rows when a piece is worth a thread
+        uint32_t grain = 16384 / job.dstWidth + 1;
+        jobsParallelFor(job.dstHeight, grain, reduceRows, &job);
+    }
+}
+
+void pyramidUpload(const Pyramid* pyramid, const uint32_t* texels) {
+    // Levels left over from a larger texture would make the chain inconsistent
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramid->levelCount - 1);
+    for(uint32_t level = 0; level < pyramid->levelCount; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, pyramid->widths[level], pyramid->heights[level], 0, GL_RGBA, GL_UNSIGNED_BYTE, texels + pyramid->offsets[level]);
+}
+
+void pyramidMinMax(const Pyramid* pyramid, const uint32_t* texels, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t* min, uint8_t* max) {
+    // Coarsest level where the rectangle still spans at most 4x4 texels
+    uint32_t level = 0;
+    while(level + 1 < pyramid->levelCount && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+        level++;
+
+    uint32_t w = pyramid->widths[level];
+    uint32_t h = pyramid->heights[level];
+    const uint32_t* data = texels + pyramid->offsets[level];
+    uint32_t tx0 = x0 >> level < w ? x0 >> level : w - 1;
+    uint32_t ty0 = y0 >> level < h ? y0 >> level : h - 1;
+    uint32_t tx1 = x1 >> level < w ? x1 >> level : w - 1;
+    uint32_t ty1 = y1 >> level < h ? y1 >> level : h - 1;
+
+    uint32_t lo = 255, hi = 0;
+    for(uint32_t y = ty0; y <= ty1; y++) {
+        for(uint32_t x = tx0; x <= tx1; x++) {
+            uint32_t texel = data[(size_t)y * w + x];
+            lo = minByte(lo, (texel >> 8) & 0xff);
+            hi = maxByte(hi, (texel >> 16) & 0xff);
+        }
+    }
+    *min = (uint8_t)lo;
+    *max = (uint8_t)hi;
+}
+
+void pyramidUpdate(const Pyramid* pyramid, uint32_t* texels, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    uint32_t rect[4] = { x0, y0, x1, y1 };
+    for(uint32_t level = 1; level < pyramid->levelCount; level++) {
+        ReduceJob job = {
+            .src = texels + pyramid->offsets[level - 1],
+            .dst = texels + pyramid->offsets[level],
+            .width = pyramid->widths[level - 1],
+            .height = pyramid->heights[level - 1],
+            .dstWidth = pyramid->widths[level],
+            .dstHeight = pyramid->heights[level]
+        };
+        parentRect(pyramid, level, rect);
+        for(uint32_t y = rect[1]; y <= rect[3]; y++) {
+            for(uint32_t x = rect[0]; x <= rect[2]; x++)
+                job.dst[(size_t)y * job.dstWidth + x] = reduceTexel(&job, x, y);
+        }
+    }
+}
+
+void pyramidUploadRect(const Pyramid* pyramid, const uint32_t* texels, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    uint32_t rect[4] = { x0, y0, x1, y1 };
+    for(uint32_t level = 0; level < pyramid->levelCount; level++) {
+        if(level > 0)
+            parentRect(pyramid, level, rect);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, pyramid->widths[level]);
+        glTexSubImage2D(GL_TEXTURE_2D, level, rect[0], rect[1], rect[2] - rect[0] + 1, rect[3] - rect[1] + 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                        texels + pyramid->offsets[level] + (size_t)rect[1] * pyramid->widths[level] + rect[0]);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
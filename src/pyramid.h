@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Mip chain of an RGBA8 heightmap built on the CPU. Red holds the 2x2 average the
+// texture is sampled with, green & blue the minimum & maximum of every level 0 texel
+// a coarse texel covers, so each level also bounds the heights of whole regions.
+// Level sizes follow GL's (halved & rounded down), the last texel of an odd row or
+// column folds the leftover texel into its minimum & maximum.
+#define PYRAMID_MAX_LEVELS 32
+
+typedef struct {
+    uint32_t levelCount;
+    uint32_t widths[PYRAMID_MAX_LEVELS];
+    uint32_t heights[PYRAMID_MAX_LEVELS];
+    // Texel offset of every level, level 0 starts the buffer
+    size_t offsets[PYRAMID_MAX_LEVELS];
+    size_t texelCount;
+} Pyramid;
+
+void pyramidInit(Pyramid* pyramid, uint32_t width, uint32_t height);
+// Fills every level past level 0 of 'texels', which holds pyramid->texelCount texels
+void pyramidBuild(const Pyramid* pyramid, uint32_t* texels);
+// Uploads every level to the bound GL_TEXTURE_2D
+void pyramidUpload(const Pyramid* pyramid, const uint32_t* texels);
+// Rebuilds the texels of every level past level 0 that cover its texels [x0, x1] x [y0, y1]
+void pyramidUpdate(const Pyramid* pyramid, uint32_t* texels, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+// Uploads the texels of every level that cover [x0, x1] x [y0, y1] of level 0 to the bound
+// GL_TEXTURE_2D, which has to hold the whole chain already
+void pyramidUploadRect(const Pyramid* pyramid, const uint32_t* texels, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+// Bounds of the level 0 heights in [x0, x1] x [y0, y1], read from a coarse level so they may be loose
+void pyramidMinMax(const Pyramid* pyramid, const uint32_t* texels, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t* min, uint8_t* max);
@@ -0,0 +1,498 @@
+#include "qem.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jobs.h"
+
+#define QEM_BLOCK_SIZE 64.0f
+#define QEM_NO_VERTEX 0xFFFFFFFFu
+// Triangles whose projected area gets below this are treated as flipped
+#define QEM_MIN_AREA 1e-6
+
+typedef struct {
+    double q[10];
+} Quadric;
+
+typedef struct {
+    double cost;
+    uint32_t v, u;
+    uint32_t stamp;
+} Candidate;
+
+// Everything a block needs, in block local vertex ids
+typedef struct {
+    // Copied in local order so the block's working set stays small
+    float* positions;
+    uint32_t* global;
+    uint32_t vertexCount;
+    uint32_t* corners;
+    uint32_t triangleCount;
+    uint32_t alive;
+    // Collapses above this cost are never taken so they are not queued either
+    double maxCost;
+
+    Quadric* quadrics;
+    uint8_t* locked;
+    uint8_t* dead;
+    uint8_t* deadTriangles;
+    uint32_t* stamps;
+    // Linked list of the corners (3 * triangle + i) of every vertex
+    uint32_t* head;
+    uint32_t* next;
+
+    Candidate* heap;
+    uint32_t heapCount, heapCapacity;
+} Block;
+
+typedef struct {
+    const float* positions;
+    const QemSettings* settings;
+    const uint8_t* locked;
+    // Triangles sorted by block, block b owns [start[b], start[b + 1])
+    uint32_t* indices;
+    const uint32_t* start;
+    uint32_t* alive;
+    double ratio;
+} Pass;
+
+static const float* pos(const Block* b, uint32_t v) {
+    return &b->positions[v * 3];
+}
+
+static void quadricAddPlane(Quadric* q, double a, double bb, double c, double d) {
+    double p[4] = { a, bb, c, d };
+    uint32_t k = 0;
+    for(uint32_t i = 0; i < 4; i++)
+        for(uint32_t j = i; j < 4; j++)
+            q->q[k++] += p[i] * p[j];
+}
+
+static double quadricEval(const Quadric* a, const Quadric* b, const float* p) {
+    double v[4] = { p[0], p[1], p[2], 1.0 };
+    double sum = 0.0;
+    uint32_t k = 0;
+    for(uint32_t i = 0; i < 4; i++) {
+        for(uint32_t j = i; j < 4; j++) {
+            double q = a->q[k] + b->q[k];
+            sum += (i == j ? 1.0 : 2.0) * q * v[i] * v[j];
+            k++;
+        }
+    }
+    return sum > 0.0 ? sum : 0.0;
+}
+
+// Twice the signed area of the triangle projected onto the xz plane
+static double area2D(const float* a, const float* b, const float* c) {
+    return (double)(b[0] - a[0]) * (c[2] - a[2]) - (double)(b[2] - a[2]) * (c[0] - a[0]);
+}
+
+static void heapPush(Block* b, Candidate c) {
+    if(b->heapCount == b->heapCapacity) {
+        b->heapCapacity = b->heapCapacity ? b->heapCapacity * 2 : 1024;
+        b->heap = realloc(b->heap, b->heapCapacity * sizeof(Candidate));
+    }
+    uint32_t i = b->heapCount++;
+    while(i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if(b->heap[parent].cost <= c.cost)
+            break;
+        b->heap[i] = b->heap[parent];
+        i = parent;
+    }
+    b->heap[i] = c;
+}
+
+static Candidate heapPop(Block* b) {
+    Candidate top = b->heap[0];
+    Candidate last = b->heap[--b->heapCount];
+    uint32_t i = 0;
+    while(true) {
+        uint32_t child = i * 2 + 1;
+        if(child >= b->heapCount)
+            break;
+        if(child + 1 < b->heapCount && b->heap[child + 1].cost < b->heap[child].cost)
+            child++;
+        if(last.cost <= b->heap[child].cost)
+            break;
+        b->heap[i] = b->heap[child];
+        i = child;
+    }
+    if(b->heapCount > 0)
+        b->heap[i] = last;
+    return top;
+}
+
+// Moving 'v' onto 'u' must keep every other triangle around 'v' the same way up
+static bool collapseValid(const Block* b, uint32_t v, uint32_t u) {
+    for(uint32_t c = b->head[v]; c != QEM_NO_VERTEX; c = b->next[c]) {
+        uint32_t t = c / 3;
+        if(b->deadTriangles[t])
+            continue;
+        const uint32_t* tri = &b->corners[t * 3];
+        if(tri[0] == u || tri[1] == u || tri[2] == u)
+            continue;
+
+        const float* p[3] = { pos(b, tri[0]), pos(b, tri[1]), pos(b, tri[2]) };
+        double before = area2D(p[0], p[1], p[2]);
+        p[c % 3] = pos(b, u);
+        double after = area2D(p[0], p[1], p[2]);
+        if(before * after <= 0.0 || fabs(after) < QEM_MIN_AREA)
+            return false;
+    }
+    return true;
+}
+
+// Pushes the cheapest valid collapse of 'v' onto one of its neighbours
+static void updateCandidate(Block* b, uint32_t v) {
+    b->stamps[v]++;
+    if(b->locked[v] || b->dead[v])
+        return;
+
+    Candidate best = { b->maxCost, v, QEM_NO_VERTEX, b->stamps[v] };
+    // Unlocked vertices are interior, so every neighbour follows 'v' in exactly one triangle
+    for(uint32_t c = b->head[v]; c != QEM_NO_VERTEX; c = b->next[c]) {
+        if(b->deadTriangles[c / 3])
+            continue;
+        uint32_t u = b->corners[c - c % 3 + (c + 1) % 3];
+        double cost = quadricEval(&b->quadrics[v], &b->quadrics[u], pos(b, u));
+        bool cheaper = best.u == QEM_NO_VERTEX ? cost <= best.cost : cost < best.cost;
+        if(cheaper && collapseValid(b, v, u)) {
+            best.cost = cost;
+            best.u = u;
+        }
+    }
+
+    if(best.u != QEM_NO_VERTEX)
+        heapPush(b, best);
+}
+
+static void collapse(Block* b, uint32_t v, uint32_t u) {
+    uint32_t c = b->head[v];
+    while(c != QEM_NO_VERTEX) {
+        uint32_t nextCorner = b->next[c];
+        uint32_t t = c / 3;
+        if(!b->deadTriangles[t]) {
+            uint32_t* tri = &b->corners[t * 3];
+            if(tri[0] == u || tri[1] == u || tri[2] == u) {
+                // The lists of its other vertices skip it from now on
+                b->deadTriangles[t] = 1;
+                b->alive--;
+            } else {
+                tri[c % 3] = u;
+                b->next[c] = b->head[u];
+                b->head[u] = c;
+            }
+        }
+        c = nextCorner;
+    }
+
+    // Drop the dead corners from the list of 'u' so later walks stay short
+    uint32_t* link = &b->head[u];
+    while(*link != QEM_NO_VERTEX) {
+        if(b->deadTriangles[*link / 3])
+            *link = b->next[*link];
+        else
+            link = &b->next[*link];
+    }
+
+    b->head[v] = QEM_NO_VERTEX;
+    b->dead[v] = 1;
+    for(uint32_t i = 0; i < 10; i++)
+        b->quadrics[u].q[i] += b->quadrics[v].q[i];
+}
+
+// LSD radix sort, 'temp' holds as many values as 'values'
+static void radixSort(uint32_t* values, uint32_t* temp, uint32_t count) {
+    for(uint32_t shift = 0; shift < 32; shift += 8) {
+        uint32_t offsets[256] = { 0 };
+        for(uint32_t i = 0; i < count; i++)
+            offsets[(values[i] >> shift) & 0xff]++;
+        uint32_t sum = 0;
+        for(uint32_t i = 0; i < 256; i++) {
+            uint32_t c = offsets[i];
+            offsets[i] = sum;
+            sum += c;
+        }
+        for(uint32_t i = 0; i < count; i++)
+            temp[offsets[(values[i] >> shift) & 0xff]++] = values[i];
+        uint32_t* swap = values;
+        values = temp;
+        temp = swap;
+    }
+}
+
+static uint32_t localId(const Block* b, uint32_t global) {
+    uint32_t lo = 0, hi = b->vertexCount;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(b->global[mid] < global)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void simplifyBlock(const Pass* pass, uint32_t index) {
+    uint32_t* indices = pass->indices + pass->start[index] * 3;
+    uint32_t count = pass->start[index + 1] - pass->start[index];
+    if(count == 0) {
+        pass->alive[index] = 0;
+        return;
+    }
+
+    Block b = { .triangleCount = count, .alive = count };
+    b.maxCost = pass->settings->maxError > 0.0f ? (double)pass->settings->maxError * pass->settings->maxError : INFINITY;
+
+    // Block local ids are the ranks of the sorted unique global ids
+    b.global = malloc(count * 3 * sizeof(uint32_t));
+    b.corners = malloc(count * 3 * sizeof(uint32_t));
+    memcpy(b.global, indices, count * 3 * sizeof(uint32_t));
+    radixSort(b.global, b.corners, count * 3);
+    for(uint32_t i = 0; i < count * 3; i++) {
+        if(i == 0 || b.global[i] != b.global[b.vertexCount - 1])
+            b.global[b.vertexCount++] = b.global[i];
+    }
+
+    uint32_t n = b.vertexCount;
+    b.positions = malloc(n * 3 * sizeof(float));
+    for(uint32_t v = 0; v < n; v++)
+        memcpy(&b.positions[v * 3], &pass->positions[b.global[v] * 3], 3 * sizeof(float));
+    b.quadrics = calloc(n, sizeof(Quadric));
+    b.locked = malloc(n);
+    b.dead = calloc(n, 1);
+    b.deadTriangles = calloc(count, 1);
+    b.stamps = calloc(n, sizeof(uint32_t));
+    b.head = malloc(n * sizeof(uint32_t));
+    b.next = malloc(count * 3 * sizeof(uint32_t));
+
+    for(uint32_t v = 0; v < n; v++) {
+        b.head[v] = QEM_NO_VERTEX;
+        b.locked[v] = pass->locked[b.global[v]];
+    }
+
+    for(uint32_t t = 0; t < count; t++) {
+        for(uint32_t i = 0; i < 3; i++) {
+            uint32_t c = t * 3 + i;
+            b.corners[c] = localId(&b, indices[c]);
+            b.next[c] = b.head[b.corners[c]];
+            b.head[b.corners[c]] = c;
+        }
+
+        const float* p0 = pos(&b, b.corners[t * 3]);
+        const float* p1 = pos(&b, b.corners[t * 3 + 1]);
+        const float* p2 = pos(&b, b.corners[t * 3 + 2]);
+        double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        double nx = e1[1] * e2[2] - e1[2] * e2[1];
+        double ny = e1[2] * e2[0] - e1[0] * e2[2];
+        double nz = e1[0] * e2[1] - e1[1] * e2[0];
+        double len = sqrt(nx * nx + ny * ny + nz * nz);
+        if(len <= 0.0)
+            continue;
+        nx /= len, ny /= len, nz /= len;
+        double d = -(nx * p0[0] + ny * p0[1] + nz * p0[2]);
+        for(uint32_t i = 0; i < 3; i++)
+            quadricAddPlane(&b.quadrics[b.corners[t * 3 + i]], nx, ny, nz, d);
+    }
+
+    for(uint32_t v = 0; v < n; v++)
+        updateCandidate(&b, v);
+
+    uint32_t target = (uint32_t)ceil(count * pass->ratio);
+    while(b.heapCount > 0 && b.alive > target) {
+        Candidate c = heapPop(&b);
+        if(c.stamp != b.stamps[c.v])
+            continue;
+
+        collapse(&b, c.v, c.u);
+        b.stamps[c.v]++;
+
+        // Every vertex around 'u' may have a new best collapse now, each is
+        // the second vertex of one triangle when walking the list
+        updateCandidate(&b, c.u);
+        for(uint32_t k = b.head[c.u]; k != QEM_NO_VERTEX; k = b.next[k])
+            updateCandidate(&b, b.corners[k - k % 3 + (k + 1) % 3]);
+    }
+
+    // The surviving triangles go back in place, with global ids
+    uint32_t out = 0;
+    for(uint32_t t = 0; t < count; t++) {
+        if(b.deadTriangles[t])
+            continue;
+        for(uint32_t i = 0; i < 3; i++)
+            indices[out * 3 + i] = b.global[b.corners[t * 3 + i]];
+        out++;
+    }
+    pass->alive[index] = out;
+
+    free(b.heap);
+    free(b.next);
+    free(b.head);
+    free(b.stamps);
+    free(b.deadTriangles);
+    free(b.dead);
+    free(b.locked);
+    free(b.quadrics);
+    free(b.corners);
+    free(b.positions);
+    free(b.global);
+}
+
+static void simplifyBlocks(void* user, uint32_t begin, uint32_t end) {
+    for(uint32_t i = begin; i < end; i++)
+        simplifyBlock(user, i);
+}
+
+// One pass over blocks offset by 'offset' block sizes, returns the new triangle count
+static uint32_t simplifyPass(const float* positions, uint32_t vertexCount, uint32_t* indices, uint32_t triangleCount, const QemSettings* settings, double ratio, float offset) {
+    // Vertex to triangle lists
+    uint32_t* offsets = calloc(vertexCount + 1, sizeof(uint32_t));
+    uint32_t* triangles = malloc(triangleCount * 3 * sizeof(uint32_t));
+    for(uint32_t i = 0; i < triangleCount * 3; i++)
+        offsets[indices[i] + 1]++;
+    for(uint32_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    uint32_t* fill = malloc(vertexCount * sizeof(uint32_t));
+    memcpy(fill, offsets, vertexCount * sizeof(uint32_t));
+    for(uint32_t i = 0; i < triangleCount * 3; i++)
+        triangles[fill[indices[i]]++] = i / 3;
+    free(fill);
+
+    // Blocks by the xz bounds of the mesh
+    float minX = INFINITY, minZ = INFINITY, maxX = -INFINITY, maxZ = -INFINITY;
+    for(uint32_t v = 0; v < vertexCount; v++) {
+        const float* p = &positions[v * 3];
+        minX = p[0] < minX ? p[0] : minX;
+        maxX = p[0] > maxX ? p[0] : maxX;
+        minZ = p[2] < minZ ? p[2] : minZ;
+        maxZ = p[2] > maxZ ? p[2] : maxZ;
+    }
+    float size = settings->blockSize > 0.0f ? settings->blockSize : QEM_BLOCK_SIZE;
+    minX -= offset * size;
+    minZ -= offset * size;
+    uint32_t blocksX = (uint32_t)((maxX - minX) / size) + 1;
+    uint32_t blocksZ = (uint32_t)((maxZ - minZ) / size) + 1;
+    uint32_t blockCount = blocksX * blocksZ;
+
+    uint32_t* blockOf = malloc(triangleCount * sizeof(uint32_t));
+    uint32_t* start = calloc(blockCount + 1, sizeof(uint32_t));
+    for(uint32_t t = 0; t < triangleCount; t++) {
+        float cx = 0.0f, cz = 0.0f;
+        for(uint32_t i = 0; i < 3; i++) {
+            cx += positions[indices[t * 3 + i] * 3];
+            cz += positions[indices[t * 3 + i] * 3 + 2];
+        }
+        uint32_t bx = (uint32_t)((cx / 3.0f - minX) / size);
+        uint32_t bz = (uint32_t)((cz / 3.0f - minZ) / size);
+        bx = bx < blocksX ? bx : blocksX - 1;
+        bz = bz < blocksZ ? bz : blocksZ - 1;
+        blockOf[t] = bz * blocksX + bx;
+        start[blockOf[t] + 1]++;
+    }
+    for(uint32_t i = 0; i < blockCount; i++)
+        start[i + 1] += start[i];
+
+    // Vertices on the border (an edge without a twin) or in more than one block are locked
+    uint8_t* locked = calloc(vertexCount, 1);
+    for(uint32_t t = 0; t < triangleCount; t++) {
+        for(uint32_t i = 0; i < 3; i++) {
+            uint32_t a = indices[t * 3 + i], b = indices[t * 3 + (i + 1) % 3];
+            bool twin = false;
+            for(uint32_t k = offsets[b]; k < offsets[b + 1] && !twin; k++) {
+                const uint32_t* o = &indices[triangles[k] * 3];
+                for(uint32_t j = 0; j < 3; j++)
+                    twin |= o[j] == b && o[(j + 1) % 3] == a;
+            }
+            if(!twin)
+                locked[a] = locked[b] = 1;
+        }
+    }
+    for(uint32_t v = 0; v < vertexCount; v++) {
+        for(uint32_t k = offsets[v]; k + 1 < offsets[v + 1]; k++) {
+            if(blockOf[triangles[k]] != blockOf[triangles[k + 1]]) {
+                locked[v] = 1;
+                break;
+            }
+        }
+    }
+    free(triangles);
+    free(offsets);
+
+    uint32_t* sorted = malloc(triangleCount * 3 * sizeof(uint32_t));
+    uint32_t* cursor = malloc(blockCount * sizeof(uint32_t));
+    memcpy(cursor, start, blockCount * sizeof(uint32_t));
+    for(uint32_t t = 0; t < triangleCount; t++)
+        memcpy(&sorted[cursor[blockOf[t]]++ * 3], &indices[t * 3], 3 * sizeof(uint32_t));
+    free(cursor);
+    free(blockOf);
+
+    uint32_t* alive = malloc(blockCount * sizeof(uint32_t));
+    Pass pass = {
+        .positions = positions,
+        .settings = settings,
+        .locked = locked,
+        .indices = sorted,
+        .start = start,
+        .alive = alive,
+        .ratio = ratio
+    };
+    jobsParallelFor(blockCount, 1, simplifyBlocks, &pass);
+
+    uint32_t out = 0;
+    for(uint32_t i = 0; i < blockCount; i++) {
+        memmove(&indices[out * 3], &sorted[start[i] * 3], alive[i] * 3 * sizeof(uint32_t));
+        out += alive[i];
+    }
+
+    free(alive);
+    free(sorted);
+    free(locked);
+    free(start);
+    return out;
+}
+
+bool qemSimplify(const float* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const QemSettings* settings, QemMesh* out) {
+    memset(out, 0, sizeof(QemMesh));
+    uint32_t triangleCount = indexCount / 3;
+    uint32_t* work = malloc(triangleCount * 3 * sizeof(uint32_t));
+    if(!work)
+        return false;
+    memcpy(work, indices, triangleCount * 3 * sizeof(uint32_t));
+
+    // Second pass over blocks shifted by half a block frees the first pass's seams
+    float offsets[] = { 0.0f, 0.5f };
+    for(uint32_t p = 0; p < 2; p++) {
+        double ratio = settings->targetTriangles > 0 ? (double)settings->targetTriangles / triangleCount : 0.0;
+        if(ratio >= 1.0)
+            break;
+        triangleCount = simplifyPass(positions, vertexCount, work, triangleCount, settings, ratio, offsets[p]);
+    }
+
+    // Drop the unused vertices
+    uint32_t* remap = malloc(vertexCount * sizeof(uint32_t));
+    for(uint32_t v = 0; v < vertexCount; v++)
+        remap[v] = QEM_NO_VERTEX;
+    out->positions = malloc(vertexCount * 3 * sizeof(float));
+    for(uint32_t i = 0; i < triangleCount * 3; i++) {
+        uint32_t v = work[i];
+        if(remap[v] == QEM_NO_VERTEX) {
+            remap[v] = out->vertexCount++;
+            memcpy(&out->positions[remap[v] * 3], &positions[v * 3], 3 * sizeof(float));
+        }
+        work[i] = remap[v];
+    }
+    free(remap);
+
+    out->indices = work;
+    out->indexCount = triangleCount * 3;
+    return true;
+}
+
+void qemFreeMesh(QemMesh* mesh) {
+    free(mesh->positions);
+    free(mesh->indices);
+    memset(mesh, 0, sizeof(QemMesh));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Quadric error metric simplification of a heightfield triangle list. The mesh
+// is cut into blocks that are simplified in parallel with their shared vertices
+// locked, a second pass over shifted blocks then simplifies the old block seams.
+// Vertices on the mesh's border never move so neighbouring tiles stay stitchable.
+
+typedef struct {
+    // Stop at this many triangles, 0 only stops at 'maxError'
+    uint32_t targetTriangles;
+    // Bound (world units) on the root of the summed squared distances from a collapsed
+    // vertex to the original planes of the triangles around both its endpoints. No single
+    // plane moves further than this, but several small moves add up. 0 allows any.
+    float maxError;
+    // Block edge in world units (x & z), 0 picks a default
+    float blockSize;
+} QemSettings;
+
+typedef struct {
+    float* positions;
+    uint32_t vertexCount;
+    uint32_t* indices;
+    uint32_t indexCount;
+} QemMesh;
+
+// 'positions' are x, y, z with y up, the triangles have to keep their winding when
+// projected onto the xz plane. Unused vertices are dropped from the output.
+bool qemSimplify(const float* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const QemSettings* settings, QemMesh* out);
+void qemFreeMesh(QemMesh* mesh);
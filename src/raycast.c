@@ -0,0 +1,316 @@
+#include "raycast.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jobs.h"
+
+// Share of a segment left out at its far end by heightTreeLineOfSight, so a target on the surface isn't its own blocker
+#define RAYCAST_SIGHT_MARGIN 1e-3f
+
+typedef struct {
+    HeightTree* tree;
+    const uint32_t* texels;
+    uint32_t level;
+} BuildJob;
+
+typedef struct {
+    const HeightTree* tree;
+    const Ray* rays;
+    RayHit* hits;
+} BatchJob;
+
+static inline uint8_t min2(uint8_t a, uint8_t b) { return a < b ? a : b; }
+static inline uint8_t max2(uint8_t a, uint8_t b) { return a > b ? a : b; }
+
+// Nodes [x0, x1] of row z of a level, from the heights or the level below
+static void buildNodes(HeightTree* tree, uint32_t level, uint32_t z, uint32_t x0, uint32_t x1) {
+    uint32_t nodesX = tree->nodesX[level];
+    uint8_t* min = tree->min + tree->offsets[level] + (size_t)z * nodesX;
+    uint8_t* max = tree->max + tree->offsets[level] + (size_t)z * nodesX;
+
+    if(level == 0) {
+        // Vertex rows z & z + 1 bound the cells between them
+        const uint8_t* h0 = tree->heights + (size_t)z * tree->width;
+        const uint8_t* h1 = h0 + tree->width;
+        for(uint32_t x = x0; x <= x1; x++) {
+            min[x] = min2(min2(h0[x], h0[x + 1]), min2(h1[x], h1[x + 1]));
+            max[x] = max2(max2(h0[x], h0[x + 1]), max2(h1[x], h1[x + 1]));
+        }
+        return;
+    }
+
+    uint32_t childX = tree->nodesX[level - 1];
+    uint32_t childZ = tree->nodesZ[level - 1];
+    const uint8_t* childMin = tree->min + tree->offsets[level - 1];
+    const uint8_t* childMax = tree->max + tree->offsets[level - 1];
+    size_t r0 = (size_t)(2 * z) * childX;
+    size_t r1 = 2 * z + 1 < childZ ? r0 + childX : r0;
+    for(uint32_t x = x0; x <= x1; x++) {
+        uint32_t c0 = 2 * x, c1 = 2 * x + 1 < childX ? 2 * x + 1 : 2 * x;
+        min[x] = min2(min2(childMin[r0 + c0], childMin[r0 + c1]), min2(childMin[r1 + c0], childMin[r1 + c1]));
+        max[x] = max2(max2(childMax[r0 + c0], childMax[r0 + c1]), max2(childMax[r1 + c0], childMax[r1 + c1]));
+    }
+}
+
+static void buildRows(void* user, uint32_t begin, uint32_t end) {
+    const BuildJob* job = user;
+    for(uint32_t z = begin; z < end; z++)
+        buildNodes(job->tree, job->level, z, 0, job->tree->nodesX[job->level] - 1);
+}
+
+static void copyHeights(void* user, uint32_t begin, uint32_t end) {
+    const BuildJob* job = user;
+    for(uint32_t z = begin; z < end; z++) {
+        for(uint32_t x = 0; x < job->tree->width; x++) {
+            size_t i = (size_t)z * job->tree->width + x;
+            job->tree->heights[i] = job->texels[i] & 0xff;
+        }
+    }
+}
+
+bool heightTreeBuild(HeightTree* tree, const uint32_t* heights, uint32_t width, uint32_t height, float unitHeight) {
+    memset(tree, 0, sizeof(HeightTree));
+    if(width < 2 || height < 2)
+        return false;
+
+    tree->width = width;
+    tree->height = height;
+    tree->unitHeight = unitHeight;
+
+    size_t nodes = 0;
+    uint32_t nodesX = width - 1, nodesZ = height - 1;
+    while(true) {
+        uint32_t level = tree->levelCount++;
+        tree->nodesX[level] = nodesX;
+        tree->nodesZ[level] = nodesZ;
+        tree->offsets[level] = nodes;
+        nodes += (size_t)nodesX * nodesZ;
+        if((nodesX == 1 && nodesZ == 1) || tree->levelCount == RAYCAST_MAX_LEVELS)
+            break;
+        nodesX = (nodesX + 1) / 2;
+        nodesZ = (nodesZ + 1) / 2;
+    }
+
+    tree->heights = malloc((size_t)width * height);
+    tree->min = malloc(nodes);
+    tree->max = malloc(nodes);
+    if(!tree->heights || !tree->min || !tree->max) {
+        heightTreeDestroy(tree);
+        return false;
+    }
+
+    BuildJob job = { tree, heights, 0 };
+    jobsParallelFor(height, 64, copyHeights, &job);
+    for(uint32_t level = 0; level < tree->levelCount; level++) {
+        job.level = level;
+        jobsParallelFor(tree->nodesZ[level], 64, buildRows, &job);
+    }
+    return true;
+}
+
+void heightTreeUpdate(HeightTree* tree, const uint32_t* heights, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1) {
+    if(tree->levelCount == 0)
+        return;
+
+    for(uint32_t z = z0; z <= z1; z++) {
+        for(uint32_t x = x0; x <= x1; x++) {
+            size_t i = (size_t)z * tree->width + x;
+            tree->heights[i] = heights[i] & 0xff;
+        }
+    }
+
+    // Cells with a corner in the rectangle, then their ancestors level by level
+    x0 = x0 > 0 ? x0 - 1 : 0;
+    z0 = z0 > 0 ? z0 - 1 : 0;
+    x1 = x1 < tree->nodesX[0] - 1 ? x1 : tree->nodesX[0] - 1;
+    z1 = z1 < tree->nodesZ[0] - 1 ? z1 : tree->nodesZ[0] - 1;
+    for(uint32_t level = 0; level < tree->levelCount; level++) {
+        for(uint32_t z = z0 >> level; z <= z1 >> level; z++)
+            buildNodes(tree, level, z, x0 >> level, x1 >> level);
+    }
+}
+
+void heightTreeDestroy(HeightTree* tree) {
+    free(tree->heights);
+    free(tree->min);
+    free(tree->max);
+    memset(tree, 0, sizeof(HeightTree));
+}
+
+uint8_t heightTreeMax(const HeightTree* tree, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1) {
+    if(tree->levelCount == 0)
+        return 0;
+
+    // Cells around the points, a point on a cell's edge is a corner of the cell before it too
+    x0 = x0 > 0 ? x0 - 1 : 0;
+    z0 = z0 > 0 ? z0 - 1 : 0;
+    x1 = x1 < tree->nodesX[0] - 1 ? x1 : tree->nodesX[0] - 1;
+    z1 = z1 < tree->nodesZ[0] - 1 ? z1 : tree->nodesZ[0] - 1;
+    uint32_t level = 0;
+    while(level + 1 < tree->levelCount && ((x1 >> level) - (x0 >> level) > 3 || (z1 >> level) - (z0 >> level) > 3))
+        level++;
+
+    const uint8_t* max = tree->max + tree->offsets[level];
+    uint8_t hi = 0;
+    for(uint32_t z = z0 >> level; z <= z1 >> level; z++) {
+        for(uint32_t x = x0 >> level; x <= x1 >> level; x++)
+            hi = max2(hi, max[(size_t)z * tree->nodesX[level] + x]);
+    }
+    return hi;
+}
+
+// First hit of the ray within [t0, t1] in cell (x, z). The diagonal splits the span
+// into at most two pieces, each over one triangle where the height above it is linear.
+static bool cellHit(const HeightTree* tree, const Ray* ray, int32_t x, int32_t z, float t0, float t1, float* t) {
+    const uint8_t* row = tree->heights + (size_t)z * tree->width + x;
+    float h00 = row[0] * tree->unitHeight;
+    float h10 = row[1] * tree->unitHeight;
+    float h01 = row[tree->width] * tree->unitHeight;
+    float h11 = row[tree->width + 1] * tree->unitHeight;
+
+    float u0 = ray->origin[0] - (float)x, v0 = ray->origin[2] - (float)z;
+    float slope = ray->dir[0] + ray->dir[2];
+    float pieces[3] = { t0, t1, t1 };
+    uint32_t pieceCount = 1;
+    if(slope != 0.0f) {
+        float diagonal = (1.0f - u0 - v0) / slope;
+        if(diagonal > t0 && diagonal < t1) {
+            pieces[1] = diagonal;
+            pieceCount = 2;
+        }
+    }
+
+    for(uint32_t p = 0; p < pieceCount; p++) {
+        float ta = pieces[p], tb = pieces[p + 1];
+        float tm = (ta + tb) * 0.5f;
+        bool lower = u0 + ray->dir[0] * tm + v0 + ray->dir[2] * tm <= 1.0f;
+
+        float f[2];
+        for(uint32_t i = 0; i < 2; i++) {
+            float s = i == 0 ? ta : tb;
+            float u = u0 + ray->dir[0] * s;
+            float v = v0 + ray->dir[2] * s;
+            float h = lower ? h00 + u * (h10 - h00) + v * (h01 - h00)
+                            : h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+            f[i] = ray->origin[1] + ray->dir[1] * s - h;
+        }
+        if(f[0] <= 0.0f) {
+            *t = ta;
+            return true;
+        }
+        if(f[1] <= 0.0f) {
+            *t = ta + (tb - ta) * f[0] / (f[0] - f[1]);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool heightTreeRaycast(const HeightTree* tree, const Ray* ray, RayHit* hit) {
+    hit->hit = false;
+    if(tree->levelCount == 0)
+        return false;
+
+    // Clip to the grid's bounding box, open below as everything under the surface is solid
+    const float* o = ray->origin;
+    const float* d = ray->dir;
+    float lo[3] = { 0.0f, -INFINITY, 0.0f };
+    float hi[3] = { (float)(tree->width - 1), 255.0f * tree->unitHeight, (float)(tree->height - 1) };
+    float t = 0.0f, tEnd = ray->maxT;
+    for(uint32_t i = 0; i < 3; i++) {
+        if(d[i] == 0.0f) {
+            if(o[i] < lo[i] || o[i] > hi[i])
+                return false;
+            continue;
+        }
+        float ta = (lo[i] - o[i]) / d[i];
+        float tb = (hi[i] - o[i]) / d[i];
+        t = fmaxf(t, fminf(ta, tb));
+        tEnd = fminf(tEnd, fmaxf(ta, tb));
+    }
+    if(t > tEnd)
+        return false;
+
+    int32_t stepX = d[0] > 0.0f ? 1 : -1;
+    int32_t stepZ = d[2] > 0.0f ? 1 : -1;
+    uint32_t level = tree->levelCount - 1;
+    int32_t x = 0, z = 0;
+    while(true) {
+        float size = (float)(1u << level);
+        float x0 = x * size, z0 = z * size;
+        float x1 = fminf(x0 + size, (float)(tree->width - 1));
+        float z1 = fminf(z0 + size, (float)(tree->height - 1));
+        float tx = d[0] > 0.0f ? (x1 - o[0]) / d[0] : (d[0] < 0.0f ? (x0 - o[0]) / d[0] : INFINITY);
+        float tz = d[2] > 0.0f ? (z1 - o[2]) / d[2] : (d[2] < 0.0f ? (z0 - o[2]) / d[2] : INFINITY);
+        float tExit = fmaxf(fminf(fminf(tx, tz), tEnd), t);
+
+        size_t node = tree->offsets[level] + (size_t)z * tree->nodesX[level] + x;
+        float lowest = fminf(o[1] + d[1] * t, o[1] + d[1] * tExit);
+        if(lowest <= tree->max[node] * tree->unitHeight) {
+            if(level > 0) {
+                // Into the child holding the ray's entry point
+                level--;
+                size *= 0.5f;
+                int32_t cx = (int32_t)floorf((o[0] + d[0] * t) / size);
+                int32_t cz = (int32_t)floorf((o[2] + d[2] * t) / size);
+                int32_t lastX = 2 * x + 1 < (int32_t)tree->nodesX[level] ? 2 * x + 1 : 2 * x;
+                int32_t lastZ = 2 * z + 1 < (int32_t)tree->nodesZ[level] ? 2 * z + 1 : 2 * z;
+                x = cx < 2 * x ? 2 * x : (cx > lastX ? lastX : cx);
+                z = cz < 2 * z ? 2 * z : (cz > lastZ ? lastZ : cz);
+                continue;
+            }
+
+            float th;
+            if(cellHit(tree, ray, x, z, t, tExit, &th)) {
+                hit->hit = true;
+                hit->t = th;
+                for(uint32_t i = 0; i < 3; i++)
+                    hit->pos[i] = o[i] + d[i] * th;
+                return true;
+            }
+        }
+        if(tExit >= tEnd)
+            return false;
+
+        // On to the neighbour the ray leaves into, then up to the highest node it's the
+        // only one of that the ray has entered
+        int32_t px = x, pz = z;
+        if(tx <= tz)
+            x += stepX;
+        if(tz <= tx)
+            z += stepZ;
+        if(x < 0 || z < 0 || x >= (int32_t)tree->nodesX[level] || z >= (int32_t)tree->nodesZ[level])
+            return false;
+        while(level + 1 < tree->levelCount && (x >> 1 != px >> 1 || z >> 1 != pz >> 1)) {
+            level++;
+            x >>= 1;
+            z >>= 1;
+            px >>= 1;
+            pz >>= 1;
+        }
+        t = tExit;
+    }
+}
+
+static void raycastRange(void* user, uint32_t begin, uint32_t end) {
+    const BatchJob* job = user;
+    for(uint32_t i = begin; i < end; i++)
+        heightTreeRaycast(job->tree, &job->rays[i], &job->hits[i]);
+}
+
+void heightTreeRaycastBatch(const HeightTree* tree, const Ray* rays, uint32_t count, RayHit* hits) {
+    BatchJob job = { tree, rays, hits };
+    jobsParallelFor(count, 256, raycastRange, &job);
+}
+
+bool heightTreeLineOfSight(const HeightTree* tree, const float a[3], const float b[3]) {
+    Ray ray = {
+        .origin = { a[0], a[1], a[2] },
+        .dir = { b[0] - a[0], b[1] - a[1], b[2] - a[2] },
+        .maxT = 1.0f - RAYCAST_SIGHT_MARGIN
+    };
+    RayHit hit;
+    return !heightTreeRaycast(tree, &ray, &hit);
+}
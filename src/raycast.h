@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Min/max quadtree over the cells of a heightmap grid for ray casting. Level 0 holds the
+// lowest & highest corner of every cell, each level above the bounds of 2x2 nodes of the
+// one below, up to a single node. Rays skip whole nodes they pass above and only test
+// the two triangles of the cells they get close to, split like the mesh's
+// ((x + 1, z) to (x, z + 1)). Positions are in grid units with y in world units.
+#define RAYCAST_MAX_LEVELS 32
+
+typedef struct {
+    uint32_t width, height;
+    float unitHeight;
+    // Vertex heights & every level's node bounds, both in heightmap units
+    uint8_t* heights;
+    uint8_t* min;
+    uint8_t* max;
+    uint32_t levelCount;
+    uint32_t nodesX[RAYCAST_MAX_LEVELS];
+    uint32_t nodesZ[RAYCAST_MAX_LEVELS];
+    size_t offsets[RAYCAST_MAX_LEVELS];
+} HeightTree;
+
+typedef struct {
+    float origin[3];
+    // Needn't be normalized, hits are reported in multiples of it up to 'maxT'
+    float dir[3];
+    float maxT;
+} Ray;
+
+typedef struct {
+    bool hit;
+    float t;
+    float pos[3];
+} RayHit;
+
+// 'heights' are RGBA8 texels with the height in red, 'unitHeight' scales them to world units
+bool heightTreeBuild(HeightTree* tree, const uint32_t* heights, uint32_t width, uint32_t height, float unitHeight);
+void heightTreeDestroy(HeightTree* tree);
+// Takes the heights of the grid points in [x0, x1] x [z0, z1] from 'heights' again and
+// rebuilds only the nodes over them
+void heightTreeUpdate(HeightTree* tree, const uint32_t* heights, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+// First point where the ray reaches the surface, a ray starting below it hits right away
+bool heightTreeRaycast(const HeightTree* tree, const Ray* ray, RayHit* hit);
+// Casts 'count' rays on every thread
+void heightTreeRaycastBatch(const HeightTree* tree, const Ray* rays, uint32_t count, RayHit* hits);
+// Upper bound on the heights of the grid points in [x0, x1] x [z0, z1] in heightmap units,
+// read from the coarsest level that still spans the rectangle with at most 4x4 nodes
+uint8_t heightTreeMax(const HeightTree* tree, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+// Whether nothing on the surface blocks the segment between 'a' & 'b'
+bool heightTreeLineOfSight(const HeightTree* tree, const float a[3], const float b[3]);
@@ -0,0 +1,231 @@
+#include "rtin.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Triangles crossing the heightmap's border are never left unsplit
+#define RTIN_FORCE_SPLIT INFINITY
+// Most grid points of the padded square per heightmap point, the tree takes 8 bytes for each
+#define RTIN_MAX_PADDING 3
+
+typedef struct {
+    const RtinTree* tree;
+    const uint32_t* data;
+    float unitHeight;
+} Heights;
+
+static float heightAt(const Heights* h, uint32_t x, uint32_t y) {
+    // Past the border the edge is repeated, those triangles are dropped anyway
+    x = x < h->tree->width ? x : h->tree->width - 1;
+    y = y < h->tree->height ? y : h->tree->height - 1;
+    return (h->data[y * h->tree->width + x] & 0xff) * h->unitHeight;
+}
+
+static uint32_t min3(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t m = a < b ? a : b;
+    return m < c ? m : c;
+}
+
+static uint32_t max3(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t m = a > b ? a : b;
+    return m > c ? m : c;
+}
+
+// -1 past the border, 1 inside & 0 crossing it
+static int classify(const RtinTree* tree, uint32_t ax, uint32_t ay, uint32_t bx, uint32_t by, uint32_t cx, uint32_t cy) {
+    if(min3(ax, bx, cx) >= tree->width - 1 || min3(ay, by, cy) >= tree->height - 1)
+        return -1;
+    if(max3(ax, bx, cx) <= tree->width - 1 && max3(ay, by, cy) <= tree->height - 1)
+        return 1;
+    return 0;
+}
+
+// Error of one of the (up to 2) triangles split by the vertex (mx, my),
+// (ax, ay) & (bx, by) is the hypotenuse & (cx, cy) the right angle
+static float triangleError(const Heights* h, uint32_t ax, uint32_t ay, uint32_t bx, uint32_t by, int cx, int cy, uint32_t mx, uint32_t my) {
+    uint32_t size = h->tree->size;
+    if(cx < 0 || cy < 0 || (uint32_t)cx >= size || (uint32_t)cy >= size)
+        return 0.0f;
+
+    int inside = classify(h->tree, ax, ay, bx, by, cx, cy);
+    if(inside < 0)
+        return 0.0f;
+    if(inside == 0)
+        return RTIN_FORCE_SPLIT;
+    return fabsf((heightAt(h, ax, ay) + heightAt(h, bx, by)) * 0.5f - heightAt(h, mx, my));
+}
+
+static void propagate(RtinTree* tree, uint32_t index, int x, int y) {
+    if(x < 0 || y < 0 || (uint32_t)x >= tree->size || (uint32_t)y >= tree->size)
+        return;
+    float e = tree->errors[y * tree->size + x];
+    if(e > tree->errors[index])
+        tree->errors[index] = e;
+}
+
+bool rtinBuild(RtinTree* tree, const uint32_t* data, uint32_t width, uint32_t height, float unitHeight) {
+    uint32_t tile = 1;
+    uint32_t largest = width > height ? width : height;
+    while(tile + 1 < largest)
+        tile *= 2;
+
+    memset(tree, 0, sizeof(RtinTree));
+    uint64_t padded = (uint64_t)(tile + 1) * (tile + 1);
+    if(width < 2 || height < 2 || padded > (uint64_t)RTIN_MAX_PADDING * width * height)
+        return false;
+
+    tree->size = tile + 1;
+    tree->width = width;
+    tree->height = height;
+    tree->errors = calloc((size_t)tree->size * tree->size, sizeof(float));
+    tree->vertexMap = calloc((size_t)tree->size * tree->size, sizeof(uint32_t));
+    if(!tree->errors || !tree->vertexMap) {
+        rtinDestroy(tree);
+        return false;
+    }
+
+    Heights h = { tree, data, unitHeight };
+    uint32_t size = tree->size;
+
+    // Finest level first so every vertex sees the final errors of its children. At
+    // half size 'r' edge vertices (on an axis aligned hypotenuse of length 2r) are
+    // finer than the square centers (on a diagonal of a 2r square) of the same 'r'.
+    for(uint32_t r = 1; r < size - 1; r *= 2) {
+        // Edge vertices, children are the square centers at r/2 around them
+        for(uint32_t y = 0; y < size; y += r) {
+            for(uint32_t x = (y / r) % 2 == 0 ? r : 0; x < size; x += 2 * r) {
+                uint32_t index = y * size + x;
+                float e;
+                if((y / r) % 2 == 0) {
+                    // Horizontal hypotenuse from (x - r, y) to (x + r, y)
+                    float up = triangleError(&h, x - r, y, x + r, y, x, (int)y - r, x, y);
+                    float down = triangleError(&h, x + r, y, x - r, y, x, y + r, x, y);
+                    e = up > down ? up : down;
+                } else {
+                    // Vertical hypotenuse from (x, y - r) to (x, y + r)
+                    float left = triangleError(&h, x, y + r, x, y - r, (int)x - r, y, x, y);
+                    float right = triangleError(&h, x, y - r, x, y + r, x + r, y, x, y);
+                    e = left > right ? left : right;
+                }
+                if(e > tree->errors[index])
+                    tree->errors[index] = e;
+
+                if(r > 1) {
+                    int s = r / 2;
+                    propagate(tree, index, x - s, y - s);
+                    propagate(tree, index, x + s, y - s);
+                    propagate(tree, index, x - s, y + s);
+                    propagate(tree, index, x + s, y + s);
+                }
+            }
+        }
+
+        // Square centers, children are the edge vertices at r around them
+        for(uint32_t y = r; y < size; y += 2 * r) {
+            for(uint32_t x = r; x < size; x += 2 * r) {
+                uint32_t index = y * size + x;
+                // The diagonal joins the two corners whose coordinates are both
+                // even or both odd multiples of 2r
+                uint32_t a = (x - r) / (2 * r), b = (y - r) / (2 * r);
+                float e0, e1;
+                if((a + b) % 2 == 0) {
+                    e0 = triangleError(&h, x - r, y - r, x + r, y + r, x + r, y - r, x, y);
+                    e1 = triangleError(&h, x + r, y + r, x - r, y - r, x - r, y + r, x, y);
+                } else {
+                    e0 = triangleError(&h, x + r, y - r, x - r, y + r, x + r, y + r, x, y);
+                    e1 = triangleError(&h, x - r, y + r, x + r, y - r, x - r, y - r, x, y);
+                }
+                float e = e0 > e1 ? e0 : e1;
+                if(e > tree->errors[index])
+                    tree->errors[index] = e;
+
+                propagate(tree, index, x - r, y);
+                propagate(tree, index, x + r, y);
+                propagate(tree, index, x, y - r);
+                propagate(tree, index, x, y + r);
+            }
+        }
+    }
+
+    return true;
+}
+
+void rtinDestroy(RtinTree* tree) {
+    free(tree->errors);
+    free(tree->vertexMap);
+    memset(tree, 0, sizeof(RtinTree));
+}
+
+typedef struct {
+    RtinTree* tree;
+    float maxError;
+    RtinMesh* mesh;
+    uint32_t vertexCapacity, indexCapacity;
+} Extract;
+
+static uint32_t addVertex(Extract* e, uint32_t x, uint32_t y) {
+    uint32_t* slot = &e->tree->vertexMap[y * e->tree->size + x];
+    if(*slot)
+        return *slot - 1;
+
+    RtinMesh* mesh = e->mesh;
+    if(mesh->vertexCount == e->vertexCapacity) {
+        e->vertexCapacity = e->vertexCapacity ? e->vertexCapacity * 2 : 1024;
+        mesh->vertices = realloc(mesh->vertices, e->vertexCapacity * sizeof(uint32_t));
+    }
+    mesh->vertices[mesh->vertexCount++] = x | y << 16;
+    *slot = mesh->vertexCount;
+    return mesh->vertexCount - 1;
+}
+
+static void extractTriangle(Extract* e, uint32_t ax, uint32_t ay, uint32_t bx, uint32_t by, uint32_t cx, uint32_t cy) {
+    int inside = classify(e->tree, ax, ay, bx, by, cx, cy);
+    if(inside < 0)
+        return;
+
+    uint32_t mx = (ax + bx) / 2, my = (ay + by) / 2;
+    bool smallest = (ax > cx ? ax - cx : cx - ax) + (ay > cy ? ay - cy : cy - ay) <= 1;
+    if(!smallest && e->tree->errors[my * e->tree->size + mx] > e->maxError) {
+        extractTriangle(e, cx, cy, ax, ay, mx, my);
+        extractTriangle(e, bx, by, cx, cy, mx, my);
+        return;
+    }
+
+    RtinMesh* mesh = e->mesh;
+    if(mesh->indexCount + 3 > e->indexCapacity) {
+        e->indexCapacity = e->indexCapacity ? e->indexCapacity * 2 : 3072;
+        mesh->indices = realloc(mesh->indices, e->indexCapacity * sizeof(uint32_t));
+    }
+    mesh->indices[mesh->indexCount++] = addVertex(e, ax, ay);
+    mesh->indices[mesh->indexCount++] = addVertex(e, bx, by);
+    mesh->indices[mesh->indexCount++] = addVertex(e, cx, cy);
+}
+
+void rtinExtract(RtinTree* tree, float maxError, RtinMesh* mesh) {
+    memset(mesh, 0, sizeof(RtinMesh));
+    if(tree->width < 2 || tree->height < 2)
+        return;
+
+    Extract e = {
+        .tree = tree,
+        .maxError = maxError,
+        .mesh = mesh
+    };
+
+    uint32_t m = tree->size - 1;
+    extractTriangle(&e, 0, 0, m, m, m, 0);
+    extractTriangle(&e, m, m, 0, 0, 0, m);
+
+    // Only the used entries are cleared so the cost stays linear in the output
+    for(uint32_t i = 0; i < mesh->vertexCount; i++) {
+        uint32_t x = mesh->vertices[i] & 0xffff, y = mesh->vertices[i] >> 16;
+        tree->vertexMap[y * tree->size + x] = 0;
+    }
+}
+
+void rtinFreeMesh(RtinMesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    memset(mesh, 0, sizeof(RtinMesh));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Right triangulated irregular network over a heightmap. Heightmaps that aren't
+// 2^k + 1 square are covered by the next such square, the triangles crossing the
+// heightmap's border are always split and the ones past it are dropped.
+typedef struct {
+    uint32_t size;
+    uint32_t width, height;
+    // Largest height error of leaving out each vertex, its descendants included
+    float* errors;
+    // Output vertex + 1 of every grid point during an extraction, zeroed again after it
+    uint32_t* vertexMap;
+} RtinTree;
+
+typedef struct {
+    // Grid coordinates, x | y << 16
+    uint32_t* vertices;
+    uint32_t vertexCount;
+    uint32_t* indices;
+    uint32_t indexCount;
+} RtinMesh;
+
+// Computes the error tree of a width x height heightmap in O(width * height),
+// a height is (data[i] & 0xff) * unitHeight. The tree takes 8 bytes per point of the
+// padded square, so it fails for heightmaps covering under a third of it (long strips,
+// or 2^k + 2 squares like 4098x4098) as well as when out of memory.
+bool rtinBuild(RtinTree* tree, const uint32_t* data, uint32_t width, uint32_t height, float unitHeight);
+void rtinDestroy(RtinTree* tree);
+// Triangulates with at most 'maxError' height difference to the full grid,
+// in time linear in the size of the output. The winding matches meshBuildIndices.
+void rtinExtract(RtinTree* tree, float maxError, RtinMesh* mesh);
+void rtinFreeMesh(RtinMesh* mesh);
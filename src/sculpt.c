@@ -0,0 +1,125 @@
+#include "sculpt.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+static inline uint32_t heightTexel(uint32_t h) {
+    return 0xff000000u | h << 16 | h << 8 | h;
+}
+
+// Uniform in [0, 1), different for every texel & seed
+static inline float dither(uint32_t x, uint32_t z, uint32_t seed) {
+    uint32_t h = x * 0x9e3779b1u ^ z * 0x85ebca77u ^ seed * 0xc2b2ae3du;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+void dirtyRectReset(DirtyRect* rect) {
+    rect->x0 = rect->z0 = UINT32_MAX;
+    rect->x1 = rect->z1 = 0;
+}
+
+bool dirtyRectEmpty(const DirtyRect* rect) {
+    return rect->x0 > rect->x1 || rect->z0 > rect->z1;
+}
+
+void dirtyRectAdd(DirtyRect* rect, const DirtyRect* other) {
+    if(dirtyRectEmpty(other))
+        return;
+    rect->x0 = other->x0 < rect->x0 ? other->x0 : rect->x0;
+    rect->z0 = other->z0 < rect->z0 ? other->z0 : rect->z0;
+    rect->x1 = other->x1 > rect->x1 ? other->x1 : rect->x1;
+    rect->z1 = other->z1 > rect->z1 ? other->z1 : rect->z1;
+}
+
+DirtyRect dirtyRectExpand(const DirtyRect* rect, uint32_t border, uint32_t width, uint32_t height) {
+    if(dirtyRectEmpty(rect))
+        return *rect;
+    DirtyRect out = {
+        .x0 = rect->x0 > border ? rect->x0 - border : 0,
+        .z0 = rect->z0 > border ? rect->z0 - border : 0,
+        .x1 = rect->x1 + border < width ? rect->x1 + border : width - 1,
+        .z1 = rect->z1 + border < height ? rect->z1 + border : height - 1
+    };
+    return out;
+}
+
+uint32_t sculptDab(uint32_t* texels, uint32_t width, uint32_t height, const SculptBrush* brush, float x, float z, float seconds, uint32_t seed, DirtyRect* dirty) {
+    float r = brush->radius;
+    if(width == 0 || height == 0 || !(r > 0.0f))
+        return 0;
+
+    float bx0 = ceilf(x - r), bz0 = ceilf(z - r), bx1 = floorf(x + r), bz1 = floorf(z + r);
+    if(bx1 < 0.0f || bz1 < 0.0f || bx0 > (float)(width - 1) || bz0 > (float)(height - 1))
+        return 0;
+    uint32_t x0 = bx0 > 0.0f ? (uint32_t)bx0 : 0;
+    uint32_t z0 = bz0 > 0.0f ? (uint32_t)bz0 : 0;
+    uint32_t x1 = bx1 < (float)(width - 1) ? (uint32_t)bx1 : width - 1;
+    uint32_t z1 = bz1 < (float)(height - 1) ? (uint32_t)bz1 : height - 1;
+
+    // Smoothing reads the heights from before the dab, one texel around it included
+    DirtyRect area = { x0, z0, x1, z1 };
+    DirtyRect around = dirtyRectExpand(&area, 1, width, height);
+    uint32_t aroundWidth = around.x1 - around.x0 + 1;
+    uint8_t* before = 0;
+    if(brush->tool == SCULPT_SMOOTH) {
+        before = malloc((size_t)aroundWidth * (around.z1 - around.z0 + 1));
+        if(!before)
+            return 0;
+        for(uint32_t tz = around.z0; tz <= around.z1; tz++) {
+            for(uint32_t tx = around.x0; tx <= around.x1; tx++)
+                before[(size_t)(tz - around.z0) * aroundWidth + tx - around.x0] = texels[(size_t)tz * width + tx] & 0xff;
+        }
+    }
+
+    DirtyRect changed;
+    dirtyRectReset(&changed);
+    uint32_t count = 0;
+    float inverseR2 = 1.0f / (r * r);
+    for(uint32_t tz = z0; tz <= z1; tz++) {
+        for(uint32_t tx = x0; tx <= x1; tx++) {
+            float dx = (float)tx - x, dz = (float)tz - z;
+            float d2 = (dx * dx + dz * dz) * inverseR2;
+            if(d2 >= 1.0f)
+                continue;
+            float falloff = (1.0f - d2) * (1.0f - d2);
+            float amount = brush->strength * seconds * falloff;
+
+            size_t i = (size_t)tz * width + tx;
+            int32_t h = (int32_t)(texels[i] & 0xff);
+            float next;
+            if(brush->tool == SCULPT_SMOOTH) {
+                uint32_t sum = 0, samples = 0;
+                for(uint32_t nz = tz > around.z0 ? tz - 1 : tz; nz <= tz + 1 && nz <= around.z1; nz++) {
+                    for(uint32_t nx = tx > around.x0 ? tx - 1 : tx; nx <= tx + 1 && nx <= around.x1; nx++) {
+                        sum += before[(size_t)(nz - around.z0) * aroundWidth + nx - around.x0];
+                        samples++;
+                    }
+                }
+                float delta = (float)sum / samples - (float)h;
+                delta = delta > amount ? amount : (delta < -amount ? -amount : delta);
+                // Rounded instead of dithered, so a smooth patch settles instead of flickering
+                next = (float)h + delta + 0.5f;
+            } else {
+                next = (float)h + (brush->tool == SCULPT_RAISE ? amount : -amount) + dither(tx, tz, seed);
+            }
+
+            int32_t rounded = (int32_t)floorf(next);
+            rounded = rounded < 0 ? 0 : (rounded > 255 ? 255 : rounded);
+            if(rounded == h)
+                continue;
+            texels[i] = heightTexel((uint32_t)rounded);
+            DirtyRect texel = { tx, tz, tx, tz };
+            dirtyRectAdd(&changed, &texel);
+            count++;
+        }
+    }
+
+    free(before);
+    dirtyRectAdd(dirty, &changed);
+    return count;
+}
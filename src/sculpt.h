@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Brushes that edit an RGBA8 heightmap in place, writing the height to red, green & blue like
+// the generated texels. Heights are bytes, so raising & lowering dither each texel's fractional
+// change and a slow brush still moves the terrain by the right amount on average. Every dab
+// grows a DirtyRect by the texels it changed, which the caller turns into partial updates of
+// everything derived from the heights.
+typedef enum {
+    SCULPT_RAISE,
+    SCULPT_LOWER,
+    // Pulls every texel towards the mean of its 3x3 neighbourhood
+    SCULPT_SMOOTH
+} SculptTool;
+
+typedef struct {
+    SculptTool tool;
+    // Grid units, the strength fades out smoothly towards it
+    float radius;
+    // Heightmap units per second at the centre, smoothing moves a texel at most that far
+    float strength;
+} SculptBrush;
+
+// Texels [x0, x1] x [z0, z1], empty when x0 > x1
+typedef struct {
+    uint32_t x0, z0, x1, z1;
+} DirtyRect;
+
+void dirtyRectReset(DirtyRect* rect);
+bool dirtyRectEmpty(const DirtyRect* rect);
+// Grows 'rect' to cover 'other' too
+void dirtyRectAdd(DirtyRect* rect, const DirtyRect* other);
+// 'rect' grown by 'border' texels on every side, clamped to a width x height grid
+DirtyRect dirtyRectExpand(const DirtyRect* rect, uint32_t border, uint32_t width, uint32_t height);
+
+// Applies 'brush' centred on grid point (x, z) for 'seconds' to the width x height texels,
+// 'seed' varies the dithering between dabs. Returns how many texels changed, their bounds
+// are added to 'dirty'.
+uint32_t sculptDab(uint32_t* texels, uint32_t width, uint32_t height, const SculptBrush* brush, float x, float z, float seconds, uint32_t seed, DirtyRect* dirty);
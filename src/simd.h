@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdint.h>
+
+// 4 wide float/int vectors, SSE2 when available and plain arrays otherwise.
+// Integer multiplication wraps like uint32_t so hashes match the scalar code.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+
+typedef __m128 F4;
+typedef __m128i I4;
+
+static inline F4 f4Load(const float* p) { return _mm_loadu_ps(p); }
+static inline void f4Store(float* p, F4 a) { _mm_storeu_ps(p, a); }
+static inline F4 f4Set1(float x) { return _mm_set1_ps(x); }
+static inline F4 f4Add(F4 a, F4 b) { return _mm_add_ps(a, b); }
+static inline F4 f4Sub(F4 a, F4 b) { return _mm_sub_ps(a, b); }
+static inline F4 f4Mul(F4 a, F4 b) { return _mm_mul_ps(a, b); }
+static inline F4 f4Div(F4 a, F4 b) { return _mm_div_ps(a, b); }
+static inline F4 f4Min(F4 a, F4 b) { return _mm_min_ps(a, b); }
+static inline F4 f4Max(F4 a, F4 b) { return _mm_max_ps(a, b); }
+static inline F4 f4Sqrt(F4 a) { return _mm_sqrt_ps(a); }
+static inline F4 f4Abs(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+// Flips the sign of every lane whose mask has bit 31 set
+static inline F4 f4FlipSign(F4 a, I4 mask) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_and_si128(mask, _mm_set1_epi32((int)0x80000000)))); }
+// Lanes where 'mask' is all ones take 'b', the others 'a'
+static inline F4 f4Select(F4 a, F4 b, F4 mask) { return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b)); }
+static inline F4 f4Less(F4 a, F4 b) { return _mm_cmplt_ps(a, b); }
+static inline F4 f4FromI4(I4 a) { return _mm_cvtepi32_ps(a); }
+// All ones in the lanes where bit 'n' of 'a' is set
+static inline F4 f4MaskFromBit(I4 a, int n) { return _mm_castsi128_ps(_mm_srai_epi32(_mm_slli_epi32(a, 31 - n), 31)); }
+
+static inline I4 i4Load(const int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void i4Store(int32_t* p, I4 a) { _mm_storeu_si128((__m128i*)p, a); }
+static inline I4 i4Set1(int32_t x) { return _mm_set1_epi32(x); }
+static inline I4 i4Add(I4 a, I4 b) { return _mm_add_epi32(a, b); }
+static inline I4 i4Sub(I4 a, I4 b) { return _mm_sub_epi32(a, b); }
+static inline I4 i4And(I4 a, I4 b) { return _mm_and_si128(a, b); }
+static inline I4 i4Or(I4 a, I4 b) { return _mm_or_si128(a, b); }
+static inline I4 i4Xor(I4 a, I4 b) { return _mm_xor_si128(a, b); }
+// ~a & b
+static inline I4 i4AndNot(I4 a, I4 b) { return _mm_andnot_si128(a, b); }
+static inline I4 i4FromF4Bits(F4 a) { return _mm_castps_si128(a); }
+static inline F4 f4FromI4Bits(I4 a) { return _mm_castsi128_ps(a); }
+static inline I4 i4Shl(I4 a, int n) { return _mm_slli_epi32(a, n); }
+static inline I4 i4Shr(I4 a, int n) { return _mm_srli_epi32(a, n); }
+static inline I4 i4Sar(I4 a, int n) { return _mm_srai_epi32(a, n); }
+static inline I4 i4Mul(I4 a, I4 b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+// Exact 16x16 -> 32 bit product, 'a' has to fit in int16_t and 'b' in [0, 32767]
+static inline I4 i4MulShort(I4 a, I4 b) { return _mm_madd_epi16(a, b); }
+static inline I4 i4Truncate(F4 a) { return _mm_cvttps_epi32(a); }
+// Per byte unsigned average (rounding up), minimum & maximum
+static inline I4 i4AvgU8(I4 a, I4 b) { return _mm_avg_epu8(a, b); }
+static inline I4 i4MinU8(I4 a, I4 b) { return _mm_min_epu8(a, b); }
+static inline I4 i4MaxU8(I4 a, I4 b) { return _mm_max_epu8(a, b); }
+// Even & odd lanes of the 8 lanes 'a' then 'b'
+static inline I4 i4Evens(I4 a, I4 b) { return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0))); }
+static inline I4 i4Odds(I4 a, I4 b) { return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1))); }
+static inline I4 i4Floor(F4 a) {
+    I4 t = _mm_cvttps_epi32(a);
+    // Truncation rounds negative values up, take one off where that happened
+    return _mm_add_epi32(t, _mm_castps_si128(_mm_cmplt_ps(a, _mm_cvtepi32_ps(t))));
+}
+
+#else
+
+#include <math.h>
+#include <string.h>
+
+typedef struct { float v[4]; } F4;
+typedef struct { int32_t v[4]; } I4;
+
+#define SIMD_LANES_F(expr) F4 r; for(int i = 0; i < 4; i++) r.v[i] = (expr); return r
+#define SIMD_LANES_I(expr) I4 r; for(int i = 0; i < 4; i++) r.v[i] = (expr); return r
+
+static inline F4 f4Load(const float* p) { SIMD_LANES_F(p[i]); }
+static inline void f4Store(float* p, F4 a) { for(int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline F4 f4Set1(float x) { SIMD_LANES_F(x); }
+static inline F4 f4Add(F4 a, F4 b) { SIMD_LANES_F(a.v[i] + b.v[i]); }
+static inline F4 f4Sub(F4 a, F4 b) { SIMD_LANES_F(a.v[i] - b.v[i]); }
+static inline F4 f4Mul(F4 a, F4 b) { SIMD_LANES_F(a.v[i] * b.v[i]); }
+static inline F4 f4Div(F4 a, F4 b) { SIMD_LANES_F(a.v[i] / b.v[i]); }
+static inline F4 f4Min(F4 a, F4 b) { SIMD_LANES_F(b.v[i] < a.v[i] ? b.v[i] : a.v[i]); }
+static inline F4 f4Max(F4 a, F4 b) { SIMD_LANES_F(b.v[i] > a.v[i] ? b.v[i] : a.v[i]); }
+static inline F4 f4Sqrt(F4 a) { SIMD_LANES_F(sqrtf(a.v[i])); }
+static inline F4 f4Abs(F4 a) { SIMD_LANES_F(fabsf(a.v[i])); }
+static inline F4 f4FlipSign(F4 a, I4 mask) { SIMD_LANES_F(mask.v[i] < 0 ? -a.v[i] : a.v[i]); }
+static inline F4 f4Less(F4 a, F4 b) {
+    F4 r;
+    for(int i = 0; i < 4; i++) {
+        uint32_t bits = a.v[i] < b.v[i] ? 0xffffffffu : 0;
+        memcpy(&r.v[i], &bits, sizeof(float));
+    }
+    return r;
+}
+static inline F4 f4Select(F4 a, F4 b, F4 mask) {
+    F4 r;
+    for(int i = 0; i < 4; i++) {
+        uint32_t bits;
+        memcpy(&bits, &mask.v[i], sizeof(float));
+        r.v[i] = bits ? b.v[i] : a.v[i];
+    }
+    return r;
+}
+static inline F4 f4FromI4(I4 a) { SIMD_LANES_F((float)a.v[i]); }
+static inline F4 f4MaskFromBit(I4 a, int n) {
+    F4 r;
+    for(int i = 0; i < 4; i++) {
+        uint32_t bits = ((uint32_t)a.v[i] >> n) & 1 ? 0xffffffffu : 0;
+        memcpy(&r.v[i], &bits, sizeof(float));
+    }
+    return r;
+}
+
+static inline I4 i4Load(const int32_t* p) { SIMD_LANES_I(p[i]); }
+static inline void i4Store(int32_t* p, I4 a) { for(int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline I4 i4Set1(int32_t x) { SIMD_LANES_I(x); }
+static inline I4 i4Add(I4 a, I4 b) { SIMD_LANES_I((int32_t)((uint32_t)a.v[i] + (uint32_t)b.v[i])); }
+static inline I4 i4Sub(I4 a, I4 b) { SIMD_LANES_I((int32_t)((uint32_t)a.v[i] - (uint32_t)b.v[i])); }
+static inline I4 i4And(I4 a, I4 b) { SIMD_LANES_I(a.v[i] & b.v[i]); }
+static inline I4 i4Or(I4 a, I4 b) { SIMD_LANES_I(a.v[i] | b.v[i]); }
+static inline I4 i4Xor(I4 a, I4 b) { SIMD_LANES_I(a.v[i] ^ b.v[i]); }
+static inline I4 i4AndNot(I4 a, I4 b) { SIMD_LANES_I(~a.v[i] & b.v[i]); }
+static inline I4 i4FromF4Bits(F4 a) { I4 r; memcpy(r.v, a.v, sizeof(r.v)); return r; }
+static inline F4 f4FromI4Bits(I4 a) { F4 r; memcpy(r.v, a.v, sizeof(r.v)); return r; }
+static inline I4 i4Shl(I4 a, int n) { SIMD_LANES_I((int32_t)((uint32_t)a.v[i] << n)); }
+static inline I4 i4Shr(I4 a, int n) { SIMD_LANES_I((int32_t)((uint32_t)a.v[i] >> n)); }
+static inline I4 i4Sar(I4 a, int n) { SIMD_LANES_I(a.v[i] >> n); }
+static inline I4 i4Mul(I4 a, I4 b) { SIMD_LANES_I((int32_t)((uint32_t)a.v[i] * (uint32_t)b.v[i])); }
+static inline I4 i4MulShort(I4 a, I4 b) { SIMD_LANES_I(a.v[i] * b.v[i]); }
+static inline I4 i4Truncate(F4 a) { SIMD_LANES_I((int32_t)a.v[i]); }
+static inline I4 i4Floor(F4 a) { SIMD_LANES_I((int32_t)floorf(a.v[i])); }
+static inline I4 i4AvgU8(I4 a, I4 b) {
+    I4 r;
+    uint8_t *x = (uint8_t*)a.v, *y = (uint8_t*)b.v, *z = (uint8_t*)r.v;
+    for(int i = 0; i < 16; i++) z[i] = (uint8_t)((x[i] + y[i] + 1) >> 1);
+    return r;
+}
+static inline I4 i4MinU8(I4 a, I4 b) {
+    I4 r;
+    uint8_t *x = (uint8_t*)a.v, *y = (uint8_t*)b.v, *z = (uint8_t*)r.v;
+    for(int i = 0; i < 16; i++) z[i] = y[i] < x[i] ? y[i] : x[i];
+    return r;
+}
+static inline I4 i4MaxU8(I4 a, I4 b) {
+    I4 r;
+    uint8_t *x = (uint8_t*)a.v, *y = (uint8_t*)b.v, *z = (uint8_t*)r.v;
+    for(int i = 0; i < 16; i++) z[i] = y[i] > x[i] ? y[i] : x[i];
+    return r;
+}
+static inline I4 i4Evens(I4 a, I4 b) { I4 r = { { a.v[0], a.v[2], b.v[0], b.v[2] } }; return r; }
+static inline I4 i4Odds(I4 a, I4 b) { I4 r = { { a.v[1], a.v[3], b.v[1], b.v[3] } }; return r; }
+
+#undef SIMD_LANES_F
+#undef SIMD_LANES_I
+
+#endif
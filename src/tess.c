@@ -0,0 +1,152 @@
+#include "tess.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// glad only loads GL 3.3, the 4.0 tessellation bits are fetched by hand
+#define GL_PATCHES 0x000E
+#define GL_PATCH_VERTICES 0x8E72
+#define GL_TESS_EVALUATION_SHADER 0x8E87
+#define GL_TESS_CONTROL_SHADER 0x8E88
+
+typedef void (APIENTRYP PatchParameteriFn)(GLenum pname, GLint value);
+
+static PatchParameteriFn patchParameteri;
+
+static uint32_t compileStage(uint32_t type, const char* source) {
+    char log[1024];
+    int success = false;
+    uint32_t shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if(!success) {
+        glGetShaderInfoLog(shader, sizeof(log), 0, log);
+        ERROR("%s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool tessInit(Tess* tess, const char* vert, const char* tesc, const char* tese, const char* frag) {
+    memset(tess, 0, sizeof(Tess));
+
+    GLint major = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    if(major < 4) {
+        ERROR("Tessellation shaders need GL 4.0, got %d.x!\n", major);
+        return false;
+    }
+
+    patchParameteri = (PatchParameteriFn)glfwGetProcAddress("glPatchParameteri");
+    if(!patchParameteri) {
+        ERROR("Couldn't load glPatchParameteri!\n");
+        return false;
+    }
+
+    uint32_t types[4] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_FRAGMENT_SHADER };
+    const char* sources[4] = { vert, tesc, tese, frag };
+    uint32_t shaders[4] = { 0 };
+    bool ok = true;
+    for(uint32_t i = 0; i < 4 && ok; i++) {
+        shaders[i] = compileStage(types[i], sources[i]);
+        ok = shaders[i] != 0;
+    }
+
+    if(ok) {
+        tess->program = glCreateProgram();
+        for(uint32_t i = 0; i < 4; i++)
+            glAttachShader(tess->program, shaders[i]);
+        glLinkProgram(tess->program);
+
+        int success = false;
+        glGetProgramiv(tess->program, GL_LINK_STATUS, &success);
+        if(!success) {
+            char log[1024];
+            glGetProgramInfoLog(tess->program, sizeof(log), 0, log);
+            ERROR("%s", log);
+            glDeleteProgram(tess->program);
+            tess->program = 0;
+            ok = false;
+        }
+    }
+
+    for(uint32_t i = 0; i < 4; i++) {
+        if(shaders[i])
+            glDeleteShader(shaders[i]);
+    }
+    if(!ok)
+        return false;
+
+    glGenVertexArrays(1, &tess->vao);
+    glGenBuffers(1, &tess->vbo);
+    glGenBuffers(1, &tess->ebo);
+    tess->available = true;
+    return true;
+}
+
+void tessDestroy(Tess* tess) {
+    if(tess->program)
+        glDeleteProgram(tess->program);
+    if(tess->vao) {
+        glDeleteBuffers(1, &tess->ebo);
+        glDeleteBuffers(1, &tess->vbo);
+        glDeleteVertexArrays(1, &tess->vao);
+    }
+    memset(tess, 0, sizeof(Tess));
+}
+
+void tessBuildPatches(Tess* tess, uint32_t gridWidth, uint32_t gridHeight, uint32_t patchSize) {
+    // Corners in the packed vertex format (grid x, height, grid z) with no height,
+    // the last row & column fall on the grid's edge
+    uint32_t cornersX = (gridWidth - 2) / patchSize + 2;
+    uint32_t cornersZ = (gridHeight - 2) / patchSize + 2;
+    uint16_t* vertices = malloc(cornersX * cornersZ * 3 * sizeof(uint16_t));
+    for(uint32_t z = 0; z < cornersZ; z++) {
+        for(uint32_t x = 0; x < cornersX; x++) {
+            uint16_t* v = &vertices[(z * cornersX + x) * 3];
+            v[0] = (uint16_t)(x * patchSize < gridWidth - 1 ? x * patchSize : gridWidth - 1);
+            v[1] = 0;
+            v[2] = (uint16_t)(z * patchSize < gridHeight - 1 ? z * patchSize : gridHeight - 1);
+        }
+    }
+
+    tess->patchCount = (cornersX - 1) * (cornersZ - 1);
+    uint32_t* indices = malloc(tess->patchCount * 4 * sizeof(uint32_t));
+    uint32_t idx = 0;
+    for(uint32_t z = 0; z + 1 < cornersZ; z++) {
+        for(uint32_t x = 0; x + 1 < cornersX; x++) {
+            indices[idx++] = z * cornersX + x;
+            indices[idx++] = z * cornersX + x + 1;
+            indices[idx++] = (z + 1) * cornersX + x + 1;
+            indices[idx++] = (z + 1) * cornersX + x;
+        }
+    }
+
+    glBindVertexArray(tess->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, tess->vbo);
+    glBufferData(GL_ARRAY_BUFFER, cornersX * cornersZ * 3 * sizeof(uint16_t), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, 3 * sizeof(uint16_t), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tess->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    tess->gridWidth = gridWidth;
+    tess->gridHeight = gridHeight;
+    free(indices);
+    free(vertices);
+}
+
+void tessDraw(Tess* tess) {
+    patchParameteri(GL_PATCH_VERTICES, 4);
+    glBindVertexArray(tess->vao);
+    glDrawElements(GL_PATCHES, tess->patchCount * 4, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
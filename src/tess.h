@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// GL 4.0 tessellation path: a coarse grid of quad patches that the GPU
+// subdivides by projected edge length & displaces from the heightmap texture.
+// The patches only depend on the grid size, never on the heights.
+typedef struct {
+    bool available;
+    uint32_t program;
+    uint32_t vao, vbo, ebo;
+    uint32_t patchCount;
+    uint32_t gridWidth, gridHeight;
+} Tess;
+
+// Needs a current GL 4.0 context, returns false (and leaves the path
+// unavailable) when tessellation shaders aren't supported or don't build
+bool tessInit(Tess* tess, const char* vert, const char* tesc, const char* tese, const char* frag);
+void tessDestroy(Tess* tess);
+// (Re)builds the patches of a width x height grid, 'patchSize' quads per side
+void tessBuildPatches(Tess* tess, uint32_t gridWidth, uint32_t gridHeight, uint32_t patchSize);
+// Draws the patches with the program bound & its uniforms set
+void tessDraw(Tess* tess);
@@ -0,0 +1,124 @@
+#include "viewshed.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "jobs.h"
+
+typedef struct {
+    const HeightTree* tree;
+    uint32_t x, z;
+    float eye;
+    float targetHeight;
+    uint8_t* mask;
+    // Points seen by each octant
+    uint64_t seen[8];
+} ViewshedJob;
+
+// Octant 'o' walks columns along x (bit 2 clear) or z (set), towards + (bit 0 clear) or -,
+// & rows towards + (bit 1 clear) or -. The axis between two octants belongs to the one whose
+// rows go towards +, the diagonal between two to the one whose columns go along x.
+static void sweepOctant(void* user, uint32_t begin, uint32_t end) {
+    ViewshedJob* job = user;
+    const HeightTree* tree = job->tree;
+    for(uint32_t o = begin; o < end; o++) {
+        bool swap = o & 4;
+        int32_t columnStep = o & 1 ? -1 : 1;
+        int32_t rowStep = o & 2 ? -1 : 1;
+        uint32_t ox = swap ? job->z : job->x, oz = swap ? job->x : job->z;
+        uint32_t w = swap ? tree->height : tree->width, h = swap ? tree->width : tree->height;
+        uint32_t columns = columnStep > 0 ? w - 1 - ox : ox;
+        uint32_t rows = rowStep > 0 ? h - 1 - oz : oz;
+        // Steps between neighbours in the mask & height arrays
+        ptrdiff_t columnStride = swap ? (ptrdiff_t)tree->width * columnStep : columnStep;
+        ptrdiff_t rowStride = swap ? rowStep : (ptrdiff_t)tree->width * rowStep;
+        bool ownAxis = rowStep > 0;
+        bool ownDiagonal = !swap;
+
+        // Horizons of the previous & current column as slopes over the column distance
+        float* prev = malloc(2 * ((size_t)rows + 1) * sizeof(float));
+        if(!prev)
+            continue;
+        float* cur = prev + rows + 1;
+
+        size_t origin = (size_t)job->z * tree->width + job->x;
+        uint64_t seen = 0;
+        for(uint32_t d = 1; d <= columns; d++) {
+            float inverse = 1.0f / d;
+            uint32_t last = d < rows ? d : rows;
+            const uint8_t* heights = tree->heights + origin + columnStride * d;
+            uint8_t* mask = job->mask + origin + columnStride * d;
+            float lowest = INFINITY;
+
+            // The line of sight to row r crosses the previous column at row r * (d - 1) / d,
+            // kept as a whole part & a remainder in 1/d
+            uint32_t a = 0, remainder = 0;
+            for(uint32_t r = 0; r <= last; r++) {
+                float horizon = -INFINITY;
+                if(d > 1) {
+                    float t = remainder * inverse;
+                    horizon = remainder ? prev[a] + (prev[a + 1] - prev[a]) * t : prev[a];
+                }
+                float height = heights[rowStride * r] * tree->unitHeight;
+                float slope = (height - job->eye) * inverse;
+                if((height + job->targetHeight - job->eye) * inverse >= horizon
+                   && (r > 0 || ownAxis) && (r < d || ownDiagonal)) {
+                    mask[rowStride * r] = 255;
+                    seen++;
+                }
+                cur[r] = slope > horizon ? slope : horizon;
+                lowest = cur[r] < lowest ? cur[r] : lowest;
+
+                remainder += d - 1;
+                if(remainder >= d) {
+                    remainder -= d;
+                    a++;
+                }
+            }
+
+            float* swapped = prev;
+            prev = cur;
+            cur = swapped;
+
+            // Horizons only rise further out, once the highest point left can't clear the
+            // lowest of them the rest of the octant is hidden
+            if(d < columns) {
+                uint32_t x0 = columnStep > 0 ? ox + d + 1 : ox - columns;
+                uint32_t x1 = columnStep > 0 ? ox + columns : ox - d - 1;
+                uint32_t z0 = rowStep > 0 ? oz : oz - rows;
+                uint32_t z1 = rowStep > 0 ? oz + rows : oz;
+                uint8_t top = swap ? heightTreeMax(tree, z0, x0, z1, x1) : heightTreeMax(tree, x0, z0, x1, z1);
+                float rise = top * tree->unitHeight + job->targetHeight - job->eye;
+                if(rise / (rise > 0.0f ? d + 1 : columns) < lowest)
+                    break;
+            }
+        }
+        job->seen[o] = seen;
+        free(prev < cur ? prev : cur);
+    }
+}
+
+uint64_t viewshedCompute(const HeightTree* tree, uint32_t x, uint32_t z, float observerHeight, float targetHeight, uint8_t* mask) {
+    memset(mask, 0, (size_t)tree->width * tree->height);
+    if(tree->levelCount == 0 || x >= tree->width || z >= tree->height)
+        return 0;
+
+    size_t origin = (size_t)z * tree->width + x;
+    ViewshedJob job = {
+        .tree = tree,
+        .x = x,
+        .z = z,
+        .eye = tree->heights[origin] * tree->unitHeight + observerHeight,
+        .targetHeight = targetHeight,
+        .mask = mask
+    };
+    jobsParallelFor(8, 1, sweepOctant, &job);
+
+    mask[origin] = 255;
+    uint64_t seen = 1;
+    for(uint32_t o = 0; o < 8; o++)
+        seen += job.seen[o];
+    return seen;
+}
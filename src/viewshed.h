@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "raycast.h"
+
+// Which grid points an observer standing on the terrain can see. Every octant around the
+// observer is swept outwards one column at a time, each point's horizon interpolated from
+// the two points of the previous column its line of sight passes between (XDraw). That's an
+// approximation of casting a ray to every point, but it touches each point once. An octant
+// stops early once the quadtree's bounds show nothing past the current column can rise
+// above the lowest horizon of it.
+
+// Marks every grid point seen from grid point ('x', 'z') with 255 & the rest with 0 in
+// 'mask', which holds one byte per grid point. The eye is 'observerHeight' world units above
+// the ground there, targets count as seen when a point 'targetHeight' above them is.
+// The octants run on every thread, returns the number of points seen.
+uint64_t viewshedCompute(const HeightTree* tree, uint32_t x, uint32_t z, float observerHeight, float targetHeight, uint8_t* mask);